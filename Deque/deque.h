@@ -1,220 +1,421 @@
 #ifndef DEQUE_H
 #define DEQUE_H
 
+#include <memory>
+#include <iterator>
+#include <type_traits>
+#include <utility>
 #include <algorithm>
-
-template <typename T>
+#include <stdexcept>
+
+// Elements live in blocks of kBlockSize slots reached through a map of block pointers.
+// Pushing at either end fills the edge block or allocates a new one, and once in a while
+// reallocates the map of pointers; elements themselves are never moved, so pushes keep
+// references valid. Iterators point into the map and are invalidated by pushes, as in std::deque.
+// Blocks are freed as soon as pops empty them. The map has one more entry than mapSize_,
+// always null, so that end() can point at it.
+//
+// Blocks are raw memory from Alloc: a slot holds an object only between the push that
+// constructs it and the pop that destroys it.
+template <typename T, typename Alloc = std::allocator<T>>
 class Deque {
-    size_t capacity_ = 0;
-    int iteratorShift_ = 0; // it is constant while reallocating
-    size_t begin_ = 0;
-    size_t end_ = 0;
-    T* data_;
+    static constexpr size_t kBlockSize = std::max<size_t>(16, 4096 / sizeof(T));
+
+    using Traits = std::allocator_traits<Alloc>;
+    using TraitsMap = typename std::allocator_traits<Alloc>::template rebind_traits<T*>;
+
+    Alloc alloc_;
+    typename std::allocator_traits<Alloc>::template rebind_alloc<T*> allocMap_;
+    T** map_ = nullptr;
+    size_t mapSize_ = 0;
+    size_t blocks_ = 0;
+    size_t begin_ = 0; // slot of the first element, slot i is map_[i / kBlockSize][i % kBlockSize]
+    size_t size_ = 0;
+
+    T* place(size_t i) const {
+        return map_[i / kBlockSize] + i % kBlockSize;
+    }
+
+    T& slot(size_t i) const {
+        return *place(i);
+    }
+
+    // blocks [firstBlock(), lastBlock()) are allocated
+    size_t firstBlock() const {
+        return begin_ / kBlockSize;
+    }
+
+    size_t lastBlock() const {
+        return (begin_ + size_ + kBlockSize - 1) / kBlockSize;
+    }
+
+    void allocate_block(size_t block) {
+        map_[block] = Traits::allocate(alloc_, kBlockSize);
+        ++blocks_;
+    }
+
+    void free_block(size_t block) {
+        Traits::deallocate(alloc_, map_[block], kBlockSize);
+        map_[block] = nullptr;
+        --blocks_;
+    }
 
     void prepare_push_front() {
-        if (begin_ > 0) return;
-        if (size() * 3 < capacity() * 2) move_to_center();
-        else realloc_up();
+        if (begin_ % kBlockSize != 0) return;
+        if (begin_ == 0) reallocate_map(1, true);
+        if (map_[begin_ / kBlockSize - 1] == nullptr) allocate_block(begin_ / kBlockSize - 1);
     }
 
     void prepare_push_back() {
-        if (end_ + 1 < capacity()) return;
-        if (size() * 3 < capacity() * 2) move_to_center();
-        else realloc_up();
-    }
-
-    void move_to_center() {
-        size_t nbegin = capacity_ / 3;
-        size_t nend = nbegin + size();
-        T* ndata = new T[capacity_];
-        std::move(data_ + begin_, data_ + end_, ndata + nbegin);
-        begin_ = nbegin;
-        end_ = nend;
-        delete[] data_;
-        data_ = ndata;
-    }
-
-    void realloc_up() {
-        size_t ncapacity = capacity_ * 3 + 3;
-        size_t nbegin = ncapacity / 3;
-        size_t nend = nbegin + size();
-        T* ndata = new T[ncapacity];
-        std::move(data_ + begin_, data_ + end_, ndata + nbegin);
-        begin_ = nbegin;
-        end_ = nend;
-        capacity_ = ncapacity;
-        delete[] data_;
-        data_ = ndata;
-    }
-
-    template <typename U, typename Container>
+        size_t block = (begin_ + size_) / kBlockSize;
+        if (block == mapSize_) reallocate_map(1, false);
+        block = (begin_ + size_) / kBlockSize;
+        if (map_[block] == nullptr) allocate_block(block);
+    }
+
+    // allocates the blocks of the n slots before begin_, their elements are not constructed
+    void reserve_front(size_t n) {
+        if (n == 0) return;
+        if (begin_ < n) reallocate_map((n - begin_ % kBlockSize + kBlockSize - 1) / kBlockSize, true);
+        allocate_blocks((begin_ - n) / kBlockSize, (begin_ - 1) / kBlockSize + 1);
+    }
+
+    // allocates the blocks of the n slots after the last element
+    void reserve_back(size_t n) {
+        if (n == 0) return;
+        size_t last = (begin_ + size_ + n - 1) / kBlockSize;
+        if (last >= mapSize_) reallocate_map(last + 1 - firstBlock() - (lastBlock() - firstBlock()), false);
+        last = (begin_ + size_ + n - 1) / kBlockSize;
+        allocate_blocks((begin_ + size_) / kBlockSize, last + 1);
+    }
+
+    void allocate_blocks(size_t from, size_t to) {
+        try {
+            for (size_t block = from; block < to; ++block) {
+                if (map_[block] == nullptr) allocate_block(block);
+            }
+        } catch (...) {
+            release_spare_blocks();
+            throw;
+        }
+    }
+
+    // frees blocks reserved around [firstBlock(), lastBlock()) that ended up unused
+    void release_spare_blocks() {
+        for (size_t block = firstBlock(); block > 0 && map_[block - 1] != nullptr; --block) {
+            free_block(block - 1);
+        }
+        for (size_t block = lastBlock(); block < mapSize_ && map_[block] != nullptr; ++block) {
+            free_block(block);
+        }
+    }
+
+    // makes room for `extra` more blocks at the front or at the back, only block pointers are moved
+    void reallocate_map(size_t extra, bool atFront) {
+        size_t first = firstBlock();
+        size_t used = lastBlock() - first;
+        size_t needed = used + extra;
+        size_t nfirst = 0;
+        if (mapSize_ > 2 * needed) {
+            nfirst = (mapSize_ - needed) / 2 + (atFront ? extra : 0);
+            if (nfirst < first) {
+                std::copy(map_ + first, map_ + first + used, map_ + nfirst);
+            } else {
+                std::copy_backward(map_ + first, map_ + first + used, map_ + nfirst + used);
+            }
+            std::fill(map_, map_ + nfirst, nullptr);
+            std::fill(map_ + nfirst + used, map_ + mapSize_, nullptr);
+        } else {
+            size_t nsize = mapSize_ + std::max(mapSize_, needed) + 2;
+            T** nmap = TraitsMap::allocate(allocMap_, nsize + 1);
+            std::fill(nmap, nmap + nsize + 1, nullptr);
+            nfirst = (nsize - needed) / 2 + (atFront ? extra : 0);
+            std::copy(map_ + first, map_ + first + used, nmap + nfirst);
+            free_map();
+            map_ = nmap;
+            mapSize_ = nsize;
+        }
+        begin_ = nfirst * kBlockSize + begin_ % kBlockSize;
+    }
+
+    void free_map() {
+        if (map_ != nullptr) TraitsMap::deallocate(allocMap_, map_, mapSize_ + 1);
+    }
+
+    // destroys the elements and frees every block, the map stays
+    void destroy_all() {
+        while (size_ > 0) {
+            pop_back();
+        }
+        if (begin_ % kBlockSize != 0) free_block(firstBlock());
+    }
+
+    // A position is the slot pointer, the start of its block and the map entry of the block, so
+    // stepping inside a block is pointer arithmetic. The block of end() may not be allocated,
+    // then the slot pointer and block start are both null.
+    template <bool isConst>
     class iterator_impl {
+    private:
+        using Block = std::conditional_t<isConst, const T*, T*>;
+
+        Block cur_ = nullptr;
+        Block first_ = nullptr;
+        T* const* node_ = nullptr;
+
+        iterator_impl(T* const* node, size_t offset): first_(*node), node_(node) {
+            cur_ = first_ + offset;
+        }
+
+        void set_node(T* const* node) {
+            node_ = node;
+            first_ = *node;
+        }
+
+        friend class Deque<T, Alloc>;
+
+        template <bool>
+        friend class iterator_impl;
+
+        // calls f(begin, end) for every piece of [first, last) lying in one block
+        template <typename F>
+        static void for_each_segment(iterator_impl first, const iterator_impl& last, F&& f) {
+            while (first.node_ != last.node_) {
+                f(first.cur_, first.first_ + kBlockSize);
+                first.set_node(first.node_ + 1);
+                first.cur_ = first.first_;
+            }
+            f(first.cur_, last.cur_);
+        }
+
+        static iterator_impl<false> copy_to(iterator_impl first, iterator_impl last, iterator_impl<false> out) {
+            for_each_segment(first, last, [&out](Block begin, Block end) {
+                while (begin != end) {
+                    std::ptrdiff_t n = std::min(end - begin, out.first_ + kBlockSize - out.cur_);
+                    std::copy(begin, begin + n, out.cur_);
+                    begin += n;
+                    out += n;
+                }
+            });
+            return out;
+        }
+
     public:
-        int index = 0;
-        Container* deque = nullptr;
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using reference = std::conditional_t<isConst, const T&, T&>;
+        using pointer = std::conditional_t<isConst, const T*, T*>;
 
         iterator_impl() = default;
 
-        iterator_impl(int index, Container* deque): index(index), deque(deque) {}
+        iterator_impl(const iterator_impl<isConst>&) = default;
 
-        iterator_impl(const iterator_impl<U, Container>&) = default;
+        iterator_impl<isConst>& operator=(const iterator_impl<isConst>&) = default;
 
-        iterator_impl<U, Container>& operator=(const iterator_impl<U, Container>&) = default;
+        operator iterator_impl<true>() const {
+            iterator_impl<true> ans;
+            ans.cur_ = cur_;
+            ans.first_ = first_;
+            ans.node_ = node_;
+            return ans;
+        }
 
-        int cur_index() const {
-            return index - deque->iteratorShift_;
+        reference operator*() const {
+            return *cur_;
         }
 
-        U& operator*() const {
-            return (*deque)[cur_index()];
+        pointer operator->() const {
+            return cur_;
         }
 
-        U* operator->() const {
-            return &(*deque)[cur_index()];
+        reference operator[](difference_type n) const {
+            return *(*this + n);
         }
 
-        iterator_impl<U, Container>& operator++() {
-            ++index;
+        iterator_impl<isConst>& operator++() {
+            if (++cur_ == first_ + kBlockSize) {
+                set_node(node_ + 1);
+                cur_ = first_;
+            }
             return *this;
         }
 
-        iterator_impl<U, Container>& operator--() {
-            --index;
+        iterator_impl<isConst>& operator--() {
+            if (cur_ == first_) {
+                set_node(node_ - 1);
+                cur_ = first_ + kBlockSize;
+            }
+            --cur_;
             return *this;
         }
 
-        iterator_impl<U, Container> operator++(int) {
+        iterator_impl<isConst> operator++(int) {
             auto res = *this;
-            ++index;
+            ++*this;
             return res;
         }
 
-        iterator_impl<U, Container> operator--(int) {
+        iterator_impl<isConst> operator--(int) {
             auto res = *this;
-            --index;
+            --*this;
             return res;
         }
 
-        iterator_impl<U, Container>& operator+=(int shift) {
-            index += shift;
+        iterator_impl<isConst>& operator+=(difference_type n) {
+            difference_type offset = n + (cur_ - first_);
+            if (offset >= 0 && offset < static_cast<difference_type>(kBlockSize)) {
+                cur_ += n;
+                return *this;
+            }
+            difference_type block = kBlockSize;
+            difference_type nodes = offset >= 0 ? offset / block : -((-offset - 1) / block) - 1;
+            set_node(node_ + nodes);
+            cur_ = first_ + (offset - nodes * block);
             return *this;
         }
 
-        iterator_impl<U, Container>& operator-=(int shift) {
-            index -= shift;
-            return *this;
+        iterator_impl<isConst>& operator-=(difference_type n) {
+            return *this += -n;
         }
 
-        bool operator<(const iterator_impl<U, Container>& that) const {
-            return index < that.index;
+        friend iterator_impl<isConst> operator+(iterator_impl<isConst> it, difference_type n) {
+            return it += n;
         }
 
-        bool operator==(const iterator_impl<U, Container>& that) const {
-            return index == that.index;
+        friend iterator_impl<isConst> operator+(difference_type n, iterator_impl<isConst> it) {
+            return it += n;
         }
 
-        bool operator!=(const iterator_impl<U, Container>& rhs) {
-            return !(*this == rhs);
+        friend iterator_impl<isConst> operator-(iterator_impl<isConst> it, difference_type n) {
+            return it -= n;
         }
 
-        bool operator>(const iterator_impl<U, Container>& rhs) {
-            return rhs < *this;
+        friend difference_type operator-(const iterator_impl<isConst>& a, const iterator_impl<isConst>& b) {
+            return (a.node_ - b.node_) * static_cast<difference_type>(kBlockSize) +
+                   (a.cur_ - a.first_) - (b.cur_ - b.first_);
         }
 
-        bool operator<=(const iterator_impl<U, Container>& rhs) {
-            return *this < rhs || *this == rhs;
+        friend bool operator==(const iterator_impl<isConst>& a, const iterator_impl<isConst>& b) {
+            return a.cur_ == b.cur_ && a.node_ == b.node_;
         }
 
-        bool operator>=(const iterator_impl& rhs) {
-            return *this > rhs || *this == rhs;
+        friend bool operator!=(const iterator_impl<isConst>& a, const iterator_impl<isConst>& b) {
+            return !(a == b);
         }
-    };
-
-public:
-    class iterator: public iterator_impl<T, Deque<T>> {
-        iterator(int index, Deque<T>* deque): iterator_impl<T, Deque<T>>(index, deque) {}
-        friend class Deque<T>;
 
-    public:
-        iterator operator+(int shift) {
-            auto ans = *this;
-            ans += shift;
-            return ans;
+        friend bool operator<(const iterator_impl<isConst>& a, const iterator_impl<isConst>& b) {
+            return a.node_ != b.node_ ? a.node_ < b.node_ : a.cur_ < b.cur_;
         }
 
-        iterator operator-(int shift) {
-            auto ans = *this;
-            ans -= shift;
-            return ans;
+        friend bool operator>(const iterator_impl<isConst>& a, const iterator_impl<isConst>& b) {
+            return b < a;
         }
 
-        int operator-(const iterator& iter) const {
-            return this->index - iter.index;
+        friend bool operator<=(const iterator_impl<isConst>& a, const iterator_impl<isConst>& b) {
+            return !(b < a);
         }
-    };
-
-    class const_iterator: public iterator_impl<const T, const Deque<T>> {
-        const_iterator(int index, const Deque<T>* deque): iterator_impl<const T, const Deque<T>>(index, deque) {}
-        friend class Deque<T>;
-    public:
-        const_iterator(const iterator& iter): const_iterator(iter.index, iter.deque) {}
 
-        const_iterator& operator=(const iterator& that) {
-            const_iterator copy = that;
-            swap(copy);
-            return *this;
+        friend bool operator>=(const iterator_impl<isConst>& a, const iterator_impl<isConst>& b) {
+            return !(a < b);
         }
 
-        const_iterator operator+(int shift) {
-            auto ans = *this;
-            ans += shift;
-            return ans;
+        // Block-by-block versions of the std algorithms, found by argument-dependent lookup when called
+        // unqualified: each block is a plain array, so the inner loops (and memmove in std::copy) run on pointers.
+        template <typename F>
+        friend F for_each(iterator_impl<isConst> first, iterator_impl<isConst> last, F f) {
+            for_each_segment(first, last, [&f](Block begin, Block end) {
+                for (; begin != end; ++begin) {
+                    f(*begin);
+                }
+            });
+            return f;
         }
 
-        const_iterator operator-(int shift) {
-            auto ans = *this;
-            ans -= shift;
-            return ans;
+        template <typename OutputIt>
+        friend OutputIt copy(iterator_impl<isConst> first, iterator_impl<isConst> last, OutputIt out) {
+            for_each_segment(first, last, [&out](Block begin, Block end) {
+                out = std::copy(begin, end, out);
+            });
+            return out;
         }
 
-        int operator-(const const_iterator& iter) {
-            return this->index - iter.index;
+        friend iterator_impl<false> copy(iterator_impl<isConst> first, iterator_impl<isConst> last,
+                                         iterator_impl<false> out) {
+            return copy_to(first, last, out);
         }
     };
 
-    Deque(): data_(new T[capacity_]) {}
+    iterator_impl<false> make_iterator(size_t slot) const {
+        if (map_ == nullptr) return iterator_impl<false>();
+        return iterator_impl<false>(map_ + slot / kBlockSize, slot % kBlockSize);
+    }
+
+public:
+    using iterator = iterator_impl<false>;
+
+    using const_iterator = iterator_impl<true>;
+
+    using reverse_iterator = std::reverse_iterator<iterator>;
+
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    Deque(): Deque(Alloc()) {}
+
+    explicit Deque(const Alloc& alloc): alloc_(alloc), allocMap_(alloc) {}
+
+    Deque(const Deque<T, Alloc>& that): Deque(Traits::select_on_container_copy_construction(that.alloc_)) {
+        for (size_t i = 0; i < that.size(); ++i) {
+            push_back(that[i]);
+        }
+    }
 
-    Deque(const Deque<T>& that): capacity_(that.size()), end_(that.size()), data_(new T[capacity_]) {
-        std::copy(that.data_ + that.begin_, that.data_ + that.end_, data_ + begin_);
+    Deque(Deque<T, Alloc>&& that) noexcept: Deque(that.alloc_) {
+        swap(that);
     }
 
-    Deque(int n, const T& value = T()): capacity_(n), end_(n), data_(new T[capacity_]) {
-        std::fill(data_ + begin_, data_ + end_, value);
+    Deque(int n, const T& value = T(), const Alloc& alloc = Alloc()): Deque(alloc) {
+        for (int i = 0; i < n; ++i) {
+            push_back(value);
+        }
     }
 
     ~Deque() {
-        delete[] data_;
+        destroy_all();
+        free_map();
     }
 
-    void swap(Deque<T>& that) {
-        std::swap(data_, that.data_);
-        std::swap(iteratorShift_, that.iteratorShift_);
+    void swap(Deque<T, Alloc>& that) noexcept {
+        std::swap(alloc_, that.alloc_);
+        std::swap(allocMap_, that.allocMap_);
+        std::swap(map_, that.map_);
+        std::swap(mapSize_, that.mapSize_);
+        std::swap(blocks_, that.blocks_);
         std::swap(begin_, that.begin_);
-        std::swap(end_, that.end_);
+        std::swap(size_, that.size_);
     }
 
-    Deque<T>& operator=(const Deque<T>& that) {
+    Deque<T, Alloc>& operator=(const Deque<T, Alloc>& that) {
         Deque tmp(that);
         swap(tmp);
         return *this;
     }
 
+    Deque<T, Alloc>& operator=(Deque<T, Alloc>&& that) noexcept {
+        Deque tmp(std::move(that));
+        swap(tmp);
+        return *this;
+    }
+
+    Alloc get_allocator() const {
+        return alloc_;
+    }
+
     T& operator[](size_t index) {
-        return data_[begin_ + index];
+        return slot(begin_ + index);
     }
 
     const T& operator[](size_t index) const {
-        return data_[begin_ + index];
+        return slot(begin_ + index);
     }
 
     const T& at(size_t index) const {
@@ -230,51 +431,104 @@ public:
     }
 
     size_t size() const {
-        return end_ - begin_;
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
     }
 
+    // destroys the elements and frees their blocks, the map is kept for the next pushes
+    void clear() {
+        destroy_all();
+        begin_ = mapSize_ / 2 * kBlockSize;
+    }
+
+    // slots in the allocated blocks
     size_t capacity() const {
-        return capacity_;
+        return blocks_ * kBlockSize;
     }
 
-    void push_back(const T& value) {
+    template <typename... Args>
+    T& emplace_back(Args&&... args) {
         prepare_push_back();
-        data_[end_++] = value;
+        size_t end = begin_ + size_;
+        try {
+            Traits::construct(alloc_, place(end), std::forward<Args>(args)...);
+        } catch (...) {
+            // the block was allocated for this element alone
+            if (end % kBlockSize == 0) free_block(end / kBlockSize);
+            throw;
+        }
+        ++size_;
+        return slot(end);
     }
 
-    void push_front(const T& value) {
+    template <typename... Args>
+    T& emplace_front(Args&&... args) {
         prepare_push_front();
-        --iteratorShift_;
-        data_[--begin_] = value;
+        try {
+            Traits::construct(alloc_, place(begin_ - 1), std::forward<Args>(args)...);
+        } catch (...) {
+            if (begin_ % kBlockSize == 0) free_block(begin_ / kBlockSize - 1);
+            throw;
+        }
+        --begin_;
+        ++size_;
+        return slot(begin_);
+    }
+
+    void push_back(const T& value) {
+        emplace_back(value);
+    }
+
+    void push_back(T&& value) {
+        emplace_back(std::move(value));
+    }
+
+    void push_front(const T& value) {
+        emplace_front(value);
+    }
+
+    void push_front(T&& value) {
+        emplace_front(std::move(value));
     }
 
     void pop_back() {
-        --end_;
+        --size_;
+        Traits::destroy(alloc_, place(begin_ + size_));
+        if ((begin_ + size_) % kBlockSize == 0) {
+            free_block((begin_ + size_) / kBlockSize);
+        }
     }
 
     void pop_front() {
-        ++iteratorShift_;
+        Traits::destroy(alloc_, place(begin_));
         ++begin_;
+        --size_;
+        if (begin_ % kBlockSize == 0) {
+            free_block(begin_ / kBlockSize - 1);
+        }
     }
 
     T& front() {
-        return data_[begin_];
+        return slot(begin_);
     }
 
     const T& front() const {
-        return data_[begin_];
+        return slot(begin_);
     }
 
     T& back() {
-        return data_[end_ - 1];
+        return slot(begin_ + size_ - 1);
     }
 
     const T& back() const {
-        return data_[end_ - 1];
+        return slot(begin_ + size_ - 1);
     }
 
     iterator begin() {
-        return iterator(iteratorShift_, this);
+        return make_iterator(begin_);
     }
 
     const_iterator begin() const {
@@ -282,7 +536,7 @@ public:
     }
 
     iterator end() {
-        return iterator(iteratorShift_ + size(), this);
+        return make_iterator(begin_ + size_);
     }
 
     const_iterator end() const {
@@ -290,23 +544,229 @@ public:
     }
 
     const_iterator cbegin() const {
-        return const_iterator(iteratorShift_, this);
+        return make_iterator(begin_);
     }
 
     const_iterator cend() const {
-        return const_iterator(iteratorShift_ + size(), this);
+        return make_iterator(begin_ + size_);
     }
 
-    void insert(const const_iterator& pos, const T& value) {
-        push_back(value);
-        int index = pos.cur_index();
-        std::rotate(data_ + begin_ + index, data_ + end_ - 1, data_ + end_);
+    reverse_iterator rbegin() {
+        return reverse_iterator(end());
     }
 
-    void erase(const const_iterator& pos) {
-        int index = pos.cur_index();
-        std::rotate(data_ + begin_ + index, data_ + begin_ + index + 1, data_ + end_);
-        pop_back();
+    const_reverse_iterator rbegin() const {
+        return crbegin();
+    }
+
+    reverse_iterator rend() {
+        return reverse_iterator(begin());
+    }
+
+    const_reverse_iterator rend() const {
+        return crend();
+    }
+
+    const_reverse_iterator crbegin() const {
+        return const_reverse_iterator(cend());
+    }
+
+    const_reverse_iterator crend() const {
+        return const_reverse_iterator(cbegin());
+    }
+
+    // Inserts and erasures shift the shorter side: elements before pos towards the front, or the ones
+    // after it towards the back. Each shifted element is moved once, either into a fresh slot or onto
+    // a slot it replaces.
+    iterator insert(const_iterator pos, const T& value) {
+        T copy(value); // value may be an element that is about to move
+        return insert_n(pos - cbegin(), 1, [&copy]() -> T&& { return std::move(copy); });
+    }
+
+    iterator insert(const_iterator pos, T&& value) {
+        T moved(std::move(value));
+        return insert_n(pos - cbegin(), 1, [&moved]() -> T&& { return std::move(moved); });
+    }
+
+    // At either end the element is built in place. Elsewhere it is built first, as args may refer to
+    // elements that are about to move, and then moved into its slot: one move on top of the shifting.
+    template <typename... Args>
+    iterator emplace(const_iterator pos, Args&&... args) {
+        size_t index = pos - cbegin();
+        if (index == 0) {
+            emplace_front(std::forward<Args>(args)...);
+            return begin();
+        }
+        if (index == size_) {
+            emplace_back(std::forward<Args>(args)...);
+            return end() - 1;
+        }
+        T value(std::forward<Args>(args)...);
+        return insert_n(index, 1, [&value]() -> T&& { return std::move(value); });
+    }
+
+    iterator insert(const_iterator pos, size_t n, const T& value) {
+        T copy(value);
+        return insert_n(pos - cbegin(), n, [&copy]() -> const T& { return copy; });
+    }
+
+    // the range must not come from this deque
+    template <typename InputIt, typename = typename std::iterator_traits<InputIt>::iterator_category>
+    iterator insert(const_iterator pos, InputIt first, InputIt last) {
+        using Category = typename std::iterator_traits<InputIt>::iterator_category;
+        if constexpr (std::is_base_of_v<std::forward_iterator_tag, Category>) {
+            size_t n = std::distance(first, last);
+            return insert_n(pos - cbegin(), n, [&first]() -> decltype(auto) { return *first++; });
+        } else {
+            size_t index = pos - cbegin();
+            Deque<T, Alloc> buffer(alloc_);
+            for (; first != last; ++first) {
+                buffer.emplace_back(*first);
+            }
+            return insert(begin() + index, std::make_move_iterator(buffer.begin()),
+                          std::make_move_iterator(buffer.end()));
+        }
+    }
+
+    iterator erase(const_iterator pos) {
+        return erase(pos, pos + 1);
+    }
+
+    iterator erase(const_iterator first, const_iterator last) {
+        size_t index = first - cbegin();
+        size_t n = last - first;
+        if (n == 0) return begin() + index;
+        if (index < size_ - index - n) {
+            std::move_backward(begin(), begin() + index, begin() + index + n);
+            for (size_t i = 0; i < n; ++i) {
+                pop_front();
+            }
+        } else {
+            std::move(begin() + index + n, end(), begin() + index);
+            for (size_t i = 0; i < n; ++i) {
+                pop_back();
+            }
+        }
+        return begin() + index;
+    }
+
+    void resize(size_t n) {
+        while (size_ > n) pop_back();
+        while (size_ < n) emplace_back();
+    }
+
+    void resize(size_t n, const T& value) {
+        while (size_ > n) pop_back();
+        while (size_ < n) push_back(value);
+    }
+
+    // blocks are freed as soon as they empty, this shrinks the map of block pointers
+    void shrink_to_fit() {
+        size_t used = lastBlock() - firstBlock();
+        if (used == 0) {
+            destroy_all();
+            free_map();
+            map_ = nullptr;
+            mapSize_ = 0;
+            begin_ = 0;
+            return;
+        }
+        if (used == mapSize_) return;
+        T** nmap = TraitsMap::allocate(allocMap_, used + 1);
+        std::copy(map_ + firstBlock(), map_ + lastBlock(), nmap);
+        nmap[used] = nullptr;
+        free_map();
+        map_ = nmap;
+        mapSize_ = used;
+        begin_ %= kBlockSize;
+    }
+
+private:
+    // inserts n elements produced by next() before the index-th one
+    template <typename Next>
+    iterator insert_n(size_t index, size_t n, Next next) {
+        if (n == 0) return begin() + index;
+        if (index < size_ - index) {
+            insert_front_side(index, n, next);
+        } else {
+            insert_back_side(index, n, next);
+        }
+        return begin() + index;
+    }
+
+    template <typename Next>
+    void insert_front_side(size_t index, size_t n, Next& next) {
+        reserve_front(n);
+        size_t oldBegin = begin_;
+        size_t newBegin = begin_ - n;
+        size_t built = 0; // raw slots [newBegin, newBegin + built) hold constructed elements
+        try {
+            // the first n slots of the result are fresh, they take the first elements
+            size_t moved = std::min(index, n);
+            for (; built < moved; ++built) {
+                Traits::construct(alloc_, place(newBegin + built), std::move(slot(oldBegin + built)));
+            }
+            for (; built < n; ++built) {
+                Traits::construct(alloc_, place(newBegin + built), next());
+            }
+        } catch (...) {
+            for (size_t i = 0; i < built; ++i) {
+                Traits::destroy(alloc_, place(newBegin + i));
+            }
+            release_spare_blocks();
+            throw;
+        }
+        begin_ = newBegin;
+        size_ += n;
+        for (size_t i = n; i < index; ++i) {
+            slot(begin_ + i) = std::move(slot(begin_ + i + n));
+        }
+        for (size_t i = std::max(index, n); i < index + n; ++i) {
+            slot(begin_ + i) = next();
+        }
+    }
+
+    template <typename Next>
+    void insert_back_side(size_t index, size_t n, Next& next) {
+        reserve_back(n);
+        size_t oldEnd = begin_ + size_;
+        size_t after = size_ - index;
+        size_t moved = std::min(after, n);
+        // the last n slots of the result are fresh, they take the last `moved` elements and,
+        // if fewer than n elements follow pos, the tail of the inserted range
+        size_t built = 0; // fresh slots [oldEnd + n - moved, oldEnd + n - moved + built)
+        size_t tail = 0;  // fresh slots [oldEnd, oldEnd + tail)
+        try {
+            for (; built < moved; ++built) {
+                Traits::construct(alloc_, place(oldEnd + n - moved + built), std::move(slot(oldEnd - moved + built)));
+            }
+            if (after < n) {
+                for (size_t i = 0; i < after; ++i) {
+                    slot(begin_ + index + i) = next();
+                }
+                for (; tail < n - after; ++tail) {
+                    Traits::construct(alloc_, place(oldEnd + tail), next());
+                }
+            }
+        } catch (...) {
+            for (size_t i = 0; i < built; ++i) {
+                Traits::destroy(alloc_, place(oldEnd + n - moved + i));
+            }
+            for (size_t i = 0; i < tail; ++i) {
+                Traits::destroy(alloc_, place(oldEnd + i));
+            }
+            release_spare_blocks();
+            throw;
+        }
+        size_ += n;
+        if (after >= n) {
+            for (size_t i = after - n; i > 0; --i) {
+                slot(begin_ + index + n + i - 1) = std::move(slot(begin_ + index + i - 1));
+            }
+            for (size_t i = 0; i < n; ++i) {
+                slot(begin_ + index + i) = next();
+            }
+        }
     }
 };
 
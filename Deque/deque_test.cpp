@@ -0,0 +1,657 @@
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <numeric>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include <cassert>
+#include "fast_allocator.h" // from ../List
+#include "deque.h"
+
+// what a Deque has taken from its allocator: maps are arrays of block pointers, blocks arrays of T
+struct MemoryStats {
+    size_t mapAllocations = 0;
+    size_t liveMapBytes = 0;
+    size_t liveBlockBytes = 0;
+};
+
+template <typename T>
+struct TrackingAllocator {
+    using value_type = T;
+
+    MemoryStats* stats;
+
+    explicit TrackingAllocator(MemoryStats* stats): stats(stats) {}
+
+    template <typename U>
+    TrackingAllocator(const TrackingAllocator<U>& other): stats(other.stats) {}
+
+    T* allocate(size_t n) {
+        if constexpr (std::is_pointer_v<T>) {
+            ++stats->mapAllocations;
+            stats->liveMapBytes += n * sizeof(T);
+        } else {
+            stats->liveBlockBytes += n * sizeof(T);
+        }
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* ptr, size_t n) {
+        (std::is_pointer_v<T> ? stats->liveMapBytes : stats->liveBlockBytes) -= n * sizeof(T);
+        std::allocator<T>().deallocate(ptr, n);
+    }
+
+    template <typename U>
+    bool operator==(const TrackingAllocator<U>& other) const {
+        return stats == other.stats;
+    }
+
+    template <typename U>
+    bool operator!=(const TrackingAllocator<U>& other) const {
+        return stats != other.stats;
+    }
+};
+
+template <typename T>
+size_t BlockSize() {
+    Deque<T> d;
+    d.emplace_back();
+    return d.capacity();
+}
+
+// pushes at either end never move elements, pops only invalidate what they remove
+void ReferenceStabilityTest(int ops, unsigned seed) {
+    std::mt19937 gen(seed);
+    Deque<int> d;
+    std::deque<const int*> addresses;
+    int next = 0;
+    for (int op = 0; op < ops; ++op) {
+        size_t kind = gen() % 16;
+        if (kind < 7) {
+            d.push_back(next++);
+            addresses.push_back(&d.back());
+        } else if (kind < 14) {
+            d.push_front(next++);
+            addresses.push_front(&d.front());
+        } else if (!addresses.empty() && kind == 14) {
+            d.pop_back();
+            addresses.pop_back();
+        } else if (!addresses.empty()) {
+            d.pop_front();
+            addresses.pop_front();
+        }
+        if (op % 997 == 0 || op + 1 == ops) {
+            assert(d.size() == addresses.size());
+            for (size_t i = 0; i < addresses.size(); ++i) {
+                assert(&d[i] == addresses[i]);
+            }
+        }
+    }
+}
+
+// growing one end reallocates the map a logarithmic number of times and never over-allocates blocks
+void MapGrowthTest() {
+    const size_t block = BlockSize<int>();
+    const int n = 300'000;
+    for (bool atBack : {true, false}) {
+        MemoryStats stats;
+        {
+            Deque<int, TrackingAllocator<int>> d{TrackingAllocator<int>(&stats)};
+            for (int i = 0; i < n; ++i) {
+                if (atBack) {
+                    d.push_back(i);
+                } else {
+                    d.push_front(i);
+                }
+            }
+            assert(stats.mapAllocations <= 16);
+            assert(d.capacity() >= d.size() && d.capacity() - d.size() < block);
+            assert(stats.liveBlockBytes == d.capacity() * sizeof(int));
+            // the map is at most a few times larger than the number of blocks it points to
+            assert(stats.liveMapBytes / sizeof(int*) <= 4 * (d.capacity() / block) + 8);
+            for (int i = 0; i < n; ++i) {
+                assert(d[i] == (atBack ? i : n - 1 - i));
+            }
+
+            // the map had room only at the grown end, the other end gets room by recentring or growing
+            for (int i = 0; i < n; ++i) {
+                if (atBack) {
+                    d.push_front(-i);
+                } else {
+                    d.push_back(-i);
+                }
+            }
+            assert(stats.mapAllocations <= 32);
+            assert(d.size() == 2 * static_cast<size_t>(n));
+            assert(d.capacity() - d.size() < 2 * block);
+            assert(d.front() == (atBack ? -(n - 1) : n - 1) && d.back() == (atBack ? n - 1 : -(n - 1)));
+        }
+        assert(stats.liveMapBytes == 0 && stats.liveBlockBytes == 0);
+    }
+}
+
+// a FIFO queue running through a deque: blocks are freed as the front passes them and the map
+// is recentred instead of growing, so memory stays bounded however many elements pass
+void SlidingQueueTest() {
+    const size_t block = BlockSize<int>();
+    for (size_t window : {1, 100, 5000}) {
+        for (bool forward : {true, false}) {
+            MemoryStats stats;
+            Deque<int, TrackingAllocator<int>> d{TrackingAllocator<int>(&stats)};
+            size_t mapAllocations = 0;
+            for (int i = 0; i < 2'000'000; ++i) {
+                if (forward) {
+                    d.push_back(i);
+                } else {
+                    d.push_front(i);
+                }
+                if (d.size() > window) {
+                    assert((forward ? d.front() : d.back()) == i - static_cast<int>(window));
+                    if (forward) {
+                        d.pop_front();
+                    } else {
+                        d.pop_back();
+                    }
+                }
+                assert(d.capacity() <= (window / block + 2) * block);
+                if (i == 100'000) {
+                    mapAllocations = stats.mapAllocations;
+                }
+            }
+            assert(stats.mapAllocations == mapAllocations);
+            assert(stats.liveMapBytes / sizeof(int*) <= 4 * (window / block + 2) + 8);
+        }
+    }
+}
+
+// counts constructions and destructions, a leak or a double destruction shows as a mismatch;
+// constructions from an int throw once `throwAfter` more of them have happened
+struct Counted {
+    static int constructed;
+    static int destroyed;
+    static int throwAfter;
+
+    int value = 0;
+
+    Counted(int value = 0): value(value) {
+        if (throwAfter >= 0 && throwAfter-- == 0) {
+            throw std::runtime_error("construction failed");
+        }
+        ++constructed;
+    }
+    Counted(const Counted& other): value(other.value) {
+        ++constructed;
+    }
+    Counted(Counted&& other) noexcept: value(other.value) {
+        ++constructed;
+    }
+    Counted& operator=(const Counted&) = default;
+    Counted& operator=(Counted&&) = default;
+    ~Counted() {
+        ++destroyed;
+    }
+
+    static int alive() {
+        return constructed - destroyed;
+    }
+};
+
+int Counted::constructed = 0;
+int Counted::destroyed = 0;
+int Counted::throwAfter = -1;
+
+template <typename Alloc>
+void LifetimeTest() {
+    using D = Deque<Counted, Alloc>;
+    const size_t block = BlockSize<Counted>();
+    const int n = 3 * static_cast<int>(block) + 5;
+    {
+        D d;
+        for (int i = 0; i < n; ++i) {
+            d.push_back(Counted(i));
+            d.emplace_front(-i);
+        }
+        assert(Counted::alive() == 2 * n && d.size() == 2 * static_cast<size_t>(n));
+
+        // pops destroy the element right away
+        for (int i = 0; i < n / 2; ++i) {
+            int before = Counted::alive();
+            d.pop_back();
+            assert(Counted::alive() == before - 1);
+            d.pop_front();
+            assert(Counted::alive() == before - 2);
+        }
+        assert(d.front().value == -(n - 1 - n / 2) && d.back().value == n - 1 - n / 2);
+
+        D copy = d;
+        assert(Counted::alive() == 2 * static_cast<int>(d.size()));
+        D moved = std::move(copy);
+        assert(Counted::alive() == 2 * static_cast<int>(d.size()));
+        copy = moved;
+        moved = std::move(d);
+        d = D();
+        assert(Counted::alive() == 2 * static_cast<int>(copy.size()));
+
+        copy.clear();
+        assert(copy.empty() && copy.capacity() == 0 && copy.begin() == copy.end());
+        assert(Counted::alive() == static_cast<int>(moved.size()));
+        for (int i = 0; i < n; ++i) {
+            copy.emplace_front(i);
+            copy.emplace_back(i);
+        }
+        copy.clear();
+        copy.clear();
+        copy.push_front(Counted(7));
+        assert(copy.size() == 1 && copy.front().value == 7);
+    }
+    assert(Counted::alive() == 0);
+
+    // a constructor throwing on a fresh block leaves neither an element nor the block behind
+    {
+        D d;
+        Counted::throwAfter = 0;
+        try {
+            d.emplace_front(1);
+            assert(false);
+        } catch (const std::runtime_error&) {
+        }
+        Counted::throwAfter = -1;
+        assert(d.empty() && d.capacity() == 0);
+        while (d.size() < d.capacity() || d.empty()) {
+            d.emplace_back(2);
+        }
+        size_t capacity = d.capacity();
+        Counted::throwAfter = 0;
+        try {
+            d.emplace_back(3);
+            assert(false);
+        } catch (const std::runtime_error&) {
+        }
+        Counted::throwAfter = -1;
+        assert(d.capacity() == capacity && d.size() == capacity && d.back().value == 2);
+        assert(Counted::alive() == static_cast<int>(d.size()));
+    }
+    assert(Counted::alive() == 0);
+    assert(Counted::constructed == Counted::destroyed);
+}
+
+void DefaultConstructionTest() {
+    Deque<int> d = {};
+    assert(d.empty() && d.size() == 0 && d.begin() == d.end() && d.capacity() == 0);
+    Deque<int> copy = d;
+    assert(copy.empty());
+    d.push_front(1);
+    assert(d.size() == 1 && d[0] == 1);
+}
+
+// a deque spanning several blocks whose first element is not at a block boundary, and its copy in std::deque
+std::pair<Deque<int>, std::deque<int>> MakeSpread(size_t blocks, unsigned seed) {
+    std::mt19937 gen(seed);
+    const size_t block = BlockSize<int>();
+    std::pair<Deque<int>, std::deque<int>> result;
+    for (size_t i = 0; i < blocks * block + block / 3; ++i) {
+        int value = static_cast<int>(gen() % 100'000);
+        if (i % 3 == 0) {
+            result.first.push_front(value);
+            result.second.push_front(value);
+        } else {
+            result.first.push_back(value);
+            result.second.push_back(value);
+        }
+    }
+    return result;
+}
+
+void IteratorTest() {
+    static_assert(std::is_same_v<std::iterator_traits<Deque<int>::iterator>::iterator_category,
+                                 std::random_access_iterator_tag>);
+    static_assert(std::is_convertible_v<Deque<int>::iterator, Deque<int>::const_iterator>);
+    static_assert(!std::is_convertible_v<Deque<int>::const_iterator, Deque<int>::iterator>);
+
+    const size_t block = BlockSize<int>();
+    auto [d, expected] = MakeSpread(5, 1);
+    const Deque<int>& constD = d;
+    const auto size = static_cast<std::ptrdiff_t>(d.size());
+    assert(d.end() - d.begin() == size && constD.end() - constD.begin() == size);
+    assert(std::equal(d.begin(), d.end(), expected.begin(), expected.end()));
+    assert(std::equal(d.rbegin(), d.rend(), expected.rbegin(), expected.rend()));
+    assert(std::equal(constD.crbegin(), constD.crend(), expected.rbegin(), expected.rend()));
+
+    std::mt19937 gen(2);
+    std::vector<std::ptrdiff_t> positions = {0, 1, size - 1, size};
+    for (std::ptrdiff_t p = 0; p <= size; p += static_cast<std::ptrdiff_t>(block)) {
+        positions.push_back(p);
+        positions.push_back(std::max<std::ptrdiff_t>(p - 1, 0));
+    }
+    for (int i = 0; i < 50; ++i) {
+        positions.push_back(gen() % (size + 1));
+    }
+    for (std::ptrdiff_t i : positions) {
+        auto it = d.begin() + i;
+        Deque<int>::const_iterator cit = it;
+        assert(it - d.begin() == i && d.end() - it == size - i);
+        assert(cit == constD.begin() + i && cit - constD.begin() == i);
+        assert(it == d.end() - (size - i));
+        if (i < size) {
+            assert(*it == d[i] && &*cit == &d[i]);
+        }
+        for (std::ptrdiff_t j : positions) {
+            auto other = d.begin() + j;
+            assert(other - it == j - i);
+            assert(j - i + it == other && it + (j - i) == other && other - (j - i) == it);
+            assert((it < other) == (i < j) && (it > other) == (i > j));
+            assert((it <= other) == (i <= j) && (it >= other) == (i >= j));
+            assert((it == other) == (i == j) && (it != other) == (i != j));
+            if (j < size) {
+                assert(it[j - i] == d[j]);
+            }
+            auto moved = it;
+            moved += j - i;
+            assert(moved == other);
+            moved -= j - i;
+            assert(moved == it);
+        }
+        if (i > 0) {
+            assert(std::prev(it) == d.begin() + (i - 1));
+            auto rit = std::make_reverse_iterator(it);
+            assert(*rit == d[i - 1] && rit.base() == it);
+        }
+        if (i < size) {
+            assert(std::next(it) == d.begin() + (i + 1));
+            assert(d.rbegin()[i] == d[size - 1 - i]);
+        }
+    }
+
+    // walking one step at a time across every block boundary, in both directions
+    auto it = d.begin();
+    for (std::ptrdiff_t i = 0; i < size; ++i, ++it) {
+        assert(*it == expected[i] && it - d.begin() == i);
+    }
+    assert(it == d.end());
+    for (std::ptrdiff_t i = size; i > 0; --i) {
+        --it;
+        assert(*it == expected[i - 1]);
+    }
+    assert(it == d.begin());
+
+    // end() of a deque filling its blocks exactly, whose block is not allocated
+    Deque<int> full;
+    while (full.empty() || full.size() < full.capacity()) {
+        full.push_back(static_cast<int>(full.size()));
+    }
+    assert(full.end() - full.begin() == static_cast<std::ptrdiff_t>(full.size()));
+    assert(full.begin() + full.size() == full.end() && full.end() - full.size() == full.begin());
+    assert(*(full.end() - 1) == full.back() && *std::prev(full.end()) == full.back());
+    assert(full.rbegin()[0] == full.back());
+
+    Deque<int> empty;
+    assert(empty.begin() == empty.end() && empty.end() - empty.begin() == 0 && empty.rbegin() == empty.rend());
+}
+
+// std algorithms that need random access work over ranges spanning several blocks
+void SortTest() {
+    const size_t block = BlockSize<int>();
+    for (unsigned seed = 1; seed <= 4; ++seed) {
+        auto [d, expected] = MakeSpread(6, seed);
+        size_t from = seed * block / 3;
+        size_t to = d.size() - seed * 7;
+        std::sort(d.begin() + from, d.begin() + to);
+        std::sort(expected.begin() + from, expected.begin() + to);
+        assert(std::equal(d.begin(), d.end(), expected.begin(), expected.end()));
+        std::sort(d.rbegin(), d.rend());
+        std::sort(expected.rbegin(), expected.rend());
+        assert(std::equal(d.begin(), d.end(), expected.begin(), expected.end()));
+        std::reverse(d.begin(), d.end());
+        std::reverse(expected.begin(), expected.end());
+        for (int value = -1; value <= 100'001; value += 997) {
+            auto lower = std::lower_bound(d.cbegin(), d.cend(), value);
+            auto upper = std::upper_bound(d.cbegin(), d.cend(), value);
+            assert(lower - d.cbegin() == std::lower_bound(expected.begin(), expected.end(), value) - expected.begin());
+            assert(upper - d.cbegin() == std::upper_bound(expected.begin(), expected.end(), value) - expected.begin());
+            assert(std::binary_search(d.begin(), d.end(), value) ==
+                   std::binary_search(expected.begin(), expected.end(), value));
+        }
+        assert(std::is_sorted(d.begin(), d.end()));
+        std::nth_element(d.begin(), d.begin() + d.size() / 2, d.end(), std::greater<int>());
+        std::nth_element(expected.begin(), expected.begin() + expected.size() / 2, expected.end(),
+                         std::greater<int>());
+        assert(d[d.size() / 2] == expected[expected.size() / 2]);
+    }
+}
+
+// the block-wise copy and for_each found by argument-dependent lookup agree with the std ones
+void BlockAlgorithmsTest() {
+    const size_t block = BlockSize<int>();
+    auto [d, expected] = MakeSpread(5, 3);
+    const Deque<int>& constD = d;
+    const size_t size = d.size();
+    std::vector<std::pair<size_t, size_t>> ranges = {
+        {0, 0}, {0, size}, {3, 3}, {0, 1}, {size - 1, size}, {block - 1, block + 1},
+        {block - 1, 3 * block + 1}, {block, 2 * block}, {5, size - 5}};
+    for (auto [from, to] : ranges) {
+        std::vector<int> out;
+        auto last = copy(d.begin() + from, d.begin() + to, std::back_inserter(out));
+        std::vector<int> stdOut;
+        std::copy(expected.begin() + from, expected.begin() + to, std::back_inserter(stdOut));
+        assert(out == stdOut);
+        *last = 1;
+        assert(out.size() == to - from + 1);
+
+        std::vector<int> raw(to - from + 1, -1);
+        int* end = copy(constD.cbegin() + from, constD.cbegin() + to, raw.data());
+        assert(end == raw.data() + (to - from));
+        assert(std::equal(raw.begin(), raw.end() - 1, stdOut.begin(), stdOut.end()) && raw.back() == -1);
+
+        long long sum = 0;
+        auto f = for_each(constD.begin() + from, constD.begin() + to, [&sum](int x) {
+            sum += x;
+        });
+        f(0);
+        assert(sum == std::accumulate(expected.begin() + from, expected.begin() + to, 0LL));
+
+        // Deque to Deque, with the destination shifted against the source's block boundaries
+        for (size_t shift : {size_t(0), size_t(1), block / 2, block - 1}) {
+            Deque<int> target(static_cast<int>(shift + (to - from) + 3), -7);
+            std::deque<int> stdTarget(shift + (to - from) + 3, -7);
+            auto out = copy(d.cbegin() + from, d.cbegin() + to, target.begin() + shift);
+            std::copy(expected.begin() + from, expected.begin() + to, stdTarget.begin() + shift);
+            assert(out == target.begin() + (shift + (to - from)));
+            assert(std::equal(target.begin(), target.end(), stdTarget.begin(), stdTarget.end()));
+        }
+    }
+
+    for_each(d.begin() + 2, d.end() - 2, [](int& x) {
+        x = -x;
+    });
+    std::for_each(expected.begin() + 2, expected.end() - 2, [](int& x) {
+        x = -x;
+    });
+    assert(std::equal(d.begin(), d.end(), expected.begin(), expected.end()));
+}
+
+template <typename Expected>
+void CheckSame(const Deque<std::string>& d, const Expected& expected) {
+    assert(d.size() == expected.size());
+    assert(d.end() - d.begin() == static_cast<std::ptrdiff_t>(d.size()));
+    assert(std::equal(d.begin(), d.end(), expected.begin(), expected.end()));
+    if (!expected.empty()) {
+        assert(d.front() == expected.front() && d.back() == expected.back());
+    }
+}
+
+// insert, emplace, erase, resize and shrink_to_fit at positions near both ends, in the middle and
+// anywhere, with empty ranges and ranges crossing block boundaries, checked against std::deque
+void RandomTest(int ops, unsigned seed) {
+    std::mt19937 gen(seed);
+    const size_t block = BlockSize<std::string>();
+    Deque<std::string> d;
+    std::deque<std::string> expected;
+    int next = 0;
+    // long enough not to fit the small string buffer, so moved-from strings are empty
+    auto value = [&next] {
+        return std::to_string(next++) + std::string(24, '.');
+    };
+    auto position = [&gen, &expected] {
+        size_t size = expected.size();
+        switch (gen() % 4) {
+            case 0: return std::min<size_t>(gen() % 3, size);
+            case 1: return size - std::min<size_t>(gen() % 3, size);
+            case 2: return size / 2;
+            default: return static_cast<size_t>(gen() % (size + 1));
+        }
+    };
+    auto count = [&gen, block] {
+        return gen() % 4 == 0 ? 0 : static_cast<size_t>(gen() % (gen() % 2 ? 4 : 3 * block));
+    };
+    for (int op = 0; op < ops; ++op) {
+        size_t pos = position();
+        size_t kind = gen() % 10;
+        if (kind == 0 && !expected.empty() && gen() % 2) {
+            // the value is an element of the deque, which may move while making room
+            size_t from = gen() % expected.size();
+            std::string s = expected[from];
+            auto it = gen() % 2 ? d.insert(d.cbegin() + pos, d[from]) : d.emplace(d.cbegin() + pos, d[from]);
+            expected.insert(expected.begin() + pos, s);
+            assert(it - d.begin() == static_cast<std::ptrdiff_t>(pos) && *it == s);
+        } else if (kind == 0) {
+            std::string s = value();
+            auto it = d.insert(d.cbegin() + pos, s);
+            expected.insert(expected.begin() + pos, s);
+            assert(it - d.begin() == static_cast<std::ptrdiff_t>(pos) && *it == s);
+        } else if (kind == 1) {
+            auto it = d.emplace(d.cbegin() + pos, 3, 'e');
+            expected.emplace(expected.begin() + pos, 3, 'e');
+            assert(it - d.begin() == static_cast<std::ptrdiff_t>(pos) && *it == "eee");
+        } else if (kind == 2) {
+            size_t n = count();
+            std::string s = value();
+            auto it = d.insert(d.cbegin() + pos, n, s);
+            // libstdc++ self-move-assigns the elements after pos when asked to insert nothing
+            if (n > 0) {
+                expected.insert(expected.begin() + pos, n, s);
+            }
+            assert(it - d.begin() == static_cast<std::ptrdiff_t>(pos));
+        } else if (kind == 3) {
+            std::vector<std::string> range(count());
+            std::generate(range.begin(), range.end(), value);
+            auto it = d.insert(d.cbegin() + pos, range.begin(), range.end());
+            if (!range.empty()) {
+                expected.insert(expected.begin() + pos, range.begin(), range.end());
+            }
+            assert(it - d.begin() == static_cast<std::ptrdiff_t>(pos));
+            assert(range.empty() || *it == range.front());
+        } else if (kind == 4) {
+            // a single-pass range, buffered before it goes in
+            std::string text;
+            for (size_t i = 0, n = count(); i < n; ++i) {
+                text += value() + " ";
+            }
+            std::istringstream in(text);
+            std::istringstream copy(text);
+            d.insert(d.cbegin() + pos, std::istream_iterator<std::string>(in), std::istream_iterator<std::string>());
+            expected.insert(expected.begin() + pos, std::istream_iterator<std::string>(copy),
+                            std::istream_iterator<std::string>());
+        } else if (kind < 7 && !expected.empty()) {
+            pos = std::min(pos, expected.size() - 1);
+            size_t n = std::min(count(), expected.size() - pos);
+            if (kind == 5) {
+                n = 1;
+                d.erase(d.cbegin() + pos);
+            } else {
+                auto it = d.erase(d.cbegin() + pos, d.cbegin() + pos + n);
+                assert(it - d.begin() == static_cast<std::ptrdiff_t>(pos));
+            }
+            expected.erase(expected.begin() + pos, expected.begin() + pos + n);
+        } else if (kind == 7) {
+            // shrink now and then, the deque stays around a few blocks
+            size_t n = expected.size() > 4 * block ? expected.size() / 3 : expected.size() + count();
+            if (gen() % 2) {
+                d.resize(n);
+                expected.resize(n);
+            } else {
+                std::string s = value();
+                d.resize(n, s);
+                expected.resize(n, s);
+            }
+        } else if (kind == 8) {
+            d.shrink_to_fit();
+            assert(d.capacity() < d.size() + 2 * block);
+        } else {
+            std::string s = value();
+            if (gen() % 2) {
+                d.push_front(s);
+                expected.push_front(s);
+            } else {
+                d.push_back(s);
+                expected.push_back(s);
+            }
+        }
+        CheckSame(d, expected);
+    }
+}
+
+// counts moves, to check how many of them an insertion takes
+struct MoveCounter {
+    static int moves;
+
+    int value = 0;
+
+    MoveCounter(int value = 0): value(value) {}
+    MoveCounter(const MoveCounter&) = default;
+    MoveCounter(MoveCounter&& other) noexcept: value(other.value) {
+        ++moves;
+    }
+    MoveCounter& operator=(const MoveCounter&) = default;
+    MoveCounter& operator=(MoveCounter&& other) noexcept {
+        value = other.value;
+        ++moves;
+        return *this;
+    }
+};
+
+int MoveCounter::moves = 0;
+
+// only the shorter side is shifted, each element of it moved once; emplace builds in place at
+// the ends and moves the new element once elsewhere
+void EmplaceMovesTest() {
+    const int n = 3 * static_cast<int>(BlockSize<MoveCounter>()) + 10;
+    for (int index : {0, 1, 2, n / 3, n / 2, n - n / 3, n - 2, n - 1, n}) {
+        Deque<MoveCounter> d;
+        for (int i = 0; i < n; ++i) {
+            d.emplace_back(i);
+        }
+        MoveCounter::moves = 0;
+        auto it = d.emplace(d.cbegin() + index, -1);
+        int shifted = std::min(index, n - index);
+        assert(MoveCounter::moves == (shifted == 0 ? 0 : shifted + 1));
+        assert(it->value == -1 && it - d.begin() == index);
+        for (int i = 0; i <= n; ++i) {
+            assert(d[i].value == (i < index ? i : i == index ? -1 : i - 1));
+        }
+
+        MoveCounter::moves = 0;
+        d.erase(d.cbegin() + index);
+        assert(MoveCounter::moves == std::min(index, n - index));
+    }
+}
+
+int main() {
+    ReferenceStabilityTest(200'000, 1);
+    ReferenceStabilityTest(20'000, 2);
+    MapGrowthTest();
+    SlidingQueueTest();
+    LifetimeTest<std::allocator<Counted>>();
+    LifetimeTest<FastAllocator<Counted>>();
+    DefaultConstructionTest();
+    IteratorTest();
+    SortTest();
+    BlockAlgorithmsTest();
+    for (unsigned seed = 1; seed <= 10; ++seed) {
+        RandomTest(2000, seed);
+    }
+    EmplaceMovesTest();
+}
@@ -0,0 +1,308 @@
+#pragma once
+
+#include <new>
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+
+// Fixed-capacity lock-free ring buffers for handing elements from producer threads to consumer
+// threads without a Deque behind a mutex. Both have the same interface: try_push_back and
+// try_pop_front fail instead of waiting when the buffer is full or empty, the batch versions move
+// as many elements as fit and return how many they moved. The capacity is rounded up to a power
+// of two, so a position is turned into a slot with a mask.
+
+namespace detail {
+
+constexpr size_t kRingCacheLine = 64;
+
+inline size_t ringCapacity(size_t capacity) {
+    size_t result = 2;
+    while (result < capacity) {
+        result *= 2;
+    }
+    return result;
+}
+
+} // namespace detail
+
+// One producer thread and one consumer thread. Each side keeps a copy of the other side's
+// position and reloads it only when the buffer looks full (or empty), so in the steady state a
+// push or pop touches only its own cache line and the slot.
+template <typename T, typename Alloc = std::allocator<T>>
+class SpscRingBuffer {
+    using Traits = std::allocator_traits<Alloc>;
+
+    Alloc alloc_;
+    T* buf_;
+    size_t mask_;
+    // written by the producer
+    alignas(detail::kRingCacheLine) std::atomic<size_t> tail_{0};
+    size_t headCache_ = 0;
+    // written by the consumer
+    alignas(detail::kRingCacheLine) std::atomic<size_t> head_{0};
+    size_t tailCache_ = 0;
+
+    T* place(size_t pos) const {
+        return buf_ + (pos & mask_);
+    }
+
+    // free slots as seen by the producer, the consumer's position is reloaded if fewer than wanted
+    size_t freeSlots(size_t tail, size_t wanted) {
+        if (mask_ + 1 - (tail - headCache_) < wanted) headCache_ = head_.load(std::memory_order_acquire);
+        return mask_ + 1 - (tail - headCache_);
+    }
+
+    // filled slots as seen by the consumer
+    size_t filledSlots(size_t head, size_t wanted) {
+        if (tailCache_ - head < wanted) tailCache_ = tail_.load(std::memory_order_acquire);
+        return tailCache_ - head;
+    }
+
+public:
+    explicit SpscRingBuffer(size_t capacity, const Alloc& alloc = Alloc()): alloc_(alloc) {
+        size_t size = detail::ringCapacity(capacity);
+        buf_ = Traits::allocate(alloc_, size);
+        mask_ = size - 1;
+    }
+
+    SpscRingBuffer(const SpscRingBuffer&) = delete;
+    SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+
+    ~SpscRingBuffer() {
+        for (size_t pos = head_.load(); pos != tail_.load(); ++pos) {
+            Traits::destroy(alloc_, place(pos));
+        }
+        Traits::deallocate(alloc_, buf_, mask_ + 1);
+    }
+
+    template <typename... Args>
+    bool try_emplace_back(Args&&... args) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (freeSlots(tail, 1) == 0) return false;
+        Traits::construct(alloc_, place(tail), std::forward<Args>(args)...);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_push_back(const T& value) {
+        return try_emplace_back(value);
+    }
+
+    bool try_push_back(T&& value) {
+        return try_emplace_back(std::move(value));
+    }
+
+    // moves the first elements of [items, items + count) in, returns how many were moved
+    size_t try_push_back(T* items, size_t count) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        count = std::min(count, freeSlots(tail, count));
+        size_t i = 0;
+        try {
+            for (; i < count; ++i) {
+                Traits::construct(alloc_, place(tail + i), std::move(items[i]));
+            }
+        } catch (...) {
+            tail_.store(tail + i, std::memory_order_release);
+            throw;
+        }
+        tail_.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    bool try_pop_front(T& out) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (filledSlots(head, 1) == 0) return false;
+        out = std::move(*place(head));
+        Traits::destroy(alloc_, place(head));
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // moves up to count elements into out[0], out[1], ..., returns how many were moved
+    size_t try_pop_front(T* out, size_t count) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        count = std::min(count, filledSlots(head, count));
+        size_t i = 0;
+        try {
+            for (; i < count; ++i) {
+                out[i] = std::move(*place(head + i));
+                Traits::destroy(alloc_, place(head + i));
+            }
+        } catch (...) {
+            head_.store(head + i, std::memory_order_release);
+            throw;
+        }
+        head_.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    size_t capacity() const {
+        return mask_ + 1;
+    }
+
+    // may be outdated by the time it returns if the other side is working
+    size_t size() const {
+        size_t head = head_.load(std::memory_order_acquire);
+        return tail_.load(std::memory_order_acquire) - head;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+};
+
+// Any number of producers and consumers. Every slot carries a sequence number telling which lap
+// of the buffer it is ready for: a producer at position p waits for sequence p, publishes p + 1
+// once the element is built, and a consumer at p takes the element and publishes p + capacity.
+// Threads claim positions (a whole run of them for the batch operations) with one CAS on the
+// shared counter, the slots themselves are not contended.
+//
+// A claimed slot has to be filled, so elements enter the buffer by nothrow moves: push builds the
+// element first, batches move from the caller's array.
+template <typename T, typename Alloc = std::allocator<T>>
+class MpmcRingBuffer {
+    static_assert(std::is_nothrow_move_constructible_v<T> && std::is_nothrow_move_assignable_v<T>,
+                  "elements are moved in and out of claimed slots, which cannot be given back");
+
+    struct Cell {
+        std::atomic<size_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* value() {
+            return std::launder(reinterpret_cast<T*>(storage));
+        }
+    };
+
+    using Traits = std::allocator_traits<Alloc>;
+    using TraitsCell = typename std::allocator_traits<Alloc>::template rebind_traits<Cell>;
+
+    Alloc alloc_;
+    typename std::allocator_traits<Alloc>::template rebind_alloc<Cell> allocCell_;
+    Cell* cells_;
+    size_t mask_;
+    alignas(detail::kRingCacheLine) std::atomic<size_t> tail_{0};
+    alignas(detail::kRingCacheLine) std::atomic<size_t> head_{0};
+
+    // claims up to count consecutive positions at `counter` whose cells are at lap `offset`
+    // (0 for producers, 1 for consumers), returns the first one and how many were claimed
+    std::pair<size_t, size_t> claim(std::atomic<size_t>& counter, size_t offset, size_t count) {
+        size_t pos = counter.load(std::memory_order_relaxed);
+        while (true) {
+            size_t ready = 0;
+            while (ready < count && ready <= mask_) {
+                size_t sequence = cells_[(pos + ready) & mask_].sequence.load(std::memory_order_acquire);
+                if (sequence != pos + ready + offset) break;
+                ++ready;
+            }
+            if (ready == 0) {
+                size_t sequence = cells_[pos & mask_].sequence.load(std::memory_order_acquire);
+                // the cell is a lap behind: full for producers, empty for consumers
+                if (static_cast<std::ptrdiff_t>(sequence - (pos + offset)) < 0) return {pos, 0};
+                pos = counter.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (counter.compare_exchange_weak(pos, pos + ready, std::memory_order_relaxed)) {
+                return {pos, ready};
+            }
+        }
+    }
+
+    void publishPush(size_t pos, T&& value) {
+        Cell& cell = cells_[pos & mask_];
+        Traits::construct(alloc_, cell.value(), std::move(value));
+        cell.sequence.store(pos + 1, std::memory_order_release);
+    }
+
+    void publishPop(size_t pos, T& out) {
+        Cell& cell = cells_[pos & mask_];
+        out = std::move(*cell.value());
+        Traits::destroy(alloc_, cell.value());
+        cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+    }
+
+public:
+    explicit MpmcRingBuffer(size_t capacity, const Alloc& alloc = Alloc()): alloc_(alloc), allocCell_(alloc) {
+        size_t size = detail::ringCapacity(capacity);
+        cells_ = TraitsCell::allocate(allocCell_, size);
+        for (size_t i = 0; i < size; ++i) {
+            ::new (static_cast<void*>(cells_ + i)) Cell();
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        mask_ = size - 1;
+    }
+
+    MpmcRingBuffer(const MpmcRingBuffer&) = delete;
+    MpmcRingBuffer& operator=(const MpmcRingBuffer&) = delete;
+
+    // no other thread may use the buffer any more
+    ~MpmcRingBuffer() {
+        for (size_t pos = head_.load(); pos != tail_.load(); ++pos) {
+            Traits::destroy(alloc_, cells_[pos & mask_].value());
+        }
+        for (size_t i = 0; i <= mask_; ++i) {
+            cells_[i].~Cell();
+        }
+        TraitsCell::deallocate(allocCell_, cells_, mask_ + 1);
+    }
+
+    template <typename... Args>
+    bool try_emplace_back(Args&&... args) {
+        T value(std::forward<Args>(args)...);
+        return try_push_back(std::move(value));
+    }
+
+    bool try_push_back(const T& value) {
+        return try_push_back(T(value));
+    }
+
+    bool try_push_back(T&& value) {
+        auto [pos, claimed] = claim(tail_, 0, 1);
+        if (claimed == 0) return false;
+        publishPush(pos, std::move(value));
+        return true;
+    }
+
+    // moves the first elements of [items, items + count) in, returns how many were moved
+    size_t try_push_back(T* items, size_t count) {
+        if (count == 0) return 0;
+        auto [pos, claimed] = claim(tail_, 0, count);
+        for (size_t i = 0; i < claimed; ++i) {
+            publishPush(pos + i, std::move(items[i]));
+        }
+        return claimed;
+    }
+
+    bool try_pop_front(T& out) {
+        auto [pos, claimed] = claim(head_, 1, 1);
+        if (claimed == 0) return false;
+        publishPop(pos, out);
+        return true;
+    }
+
+    // moves up to count elements into out[0], out[1], ..., returns how many were moved
+    size_t try_pop_front(T* out, size_t count) {
+        if (count == 0) return 0;
+        auto [pos, claimed] = claim(head_, 1, count);
+        for (size_t i = 0; i < claimed; ++i) {
+            publishPop(pos + i, out[i]);
+        }
+        return claimed;
+    }
+
+    size_t capacity() const {
+        return mask_ + 1;
+    }
+
+    // may be outdated by the time it returns if other threads are pushing or popping
+    size_t size() const {
+        size_t head = head_.load(std::memory_order_acquire);
+        size_t tail = tail_.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+};
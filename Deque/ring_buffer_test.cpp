@@ -0,0 +1,152 @@
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cassert>
+#include "ring_buffer.h"
+
+void TestCapacity() {
+    assert(detail::ringCapacity(0) == 2);
+    assert(detail::ringCapacity(1) == 2);
+    assert(detail::ringCapacity(2) == 2);
+    assert(detail::ringCapacity(3) == 4);
+    assert(detail::ringCapacity(1000) == 1024);
+    assert(detail::ringCapacity(1024) == 1024);
+
+    SpscRingBuffer<int> spsc(5);
+    assert(spsc.capacity() == 8);
+    MpmcRingBuffer<int> mpmc(1);
+    assert(mpmc.capacity() == 2);
+}
+
+template <typename Buffer>
+void SimpleTest() {
+    Buffer buffer(4);
+    std::string s;
+    assert(buffer.empty());
+    assert(!buffer.try_pop_front(s));
+
+    std::string first = "first";
+    assert(buffer.try_push_back(first));
+    assert(first == "first");
+    assert(buffer.try_push_back(std::string("second")));
+    assert(buffer.try_emplace_back(3, 'x'));
+    assert(buffer.try_push_back("fourth"));
+    assert(buffer.size() == 4);
+
+    // full: a failed push leaves its argument alone
+    std::string fifth = "fifth";
+    assert(!buffer.try_push_back(std::move(fifth)));
+    assert(fifth == "fifth");
+
+    assert(buffer.try_pop_front(s) && s == "first");
+    assert(buffer.try_pop_front(s) && s == "second");
+    assert(buffer.try_push_back(std::move(fifth)));
+    assert(buffer.try_pop_front(s) && s == "xxx");
+    assert(buffer.try_pop_front(s) && s == "fourth");
+    assert(buffer.try_pop_front(s) && s == "fifth");
+    assert(!buffer.try_pop_front(s));
+    assert(buffer.empty());
+
+    // whatever is left is destroyed with the buffer
+    buffer.try_push_back("left");
+    buffer.try_push_back("over");
+}
+
+template <typename Buffer>
+void BatchTest() {
+    Buffer buffer(8);
+    std::vector<std::string> in;
+    for (int i = 0; i < 12; ++i) {
+        in.push_back(std::to_string(i));
+    }
+
+    // only as many as fit are moved in, the rest stay with the caller
+    assert(buffer.try_push_back(in.data(), 12) == 8);
+    assert(in[8] == "8" && in[11] == "11");
+    assert(buffer.try_push_back(in.data() + 8, 4) == 0);
+
+    std::string out[16];
+    assert(buffer.try_pop_front(out, 3) == 3);
+    assert(out[0] == "0" && out[2] == "2");
+    assert(buffer.try_push_back(in.data() + 8, 4) == 3);
+    assert(buffer.try_pop_front(out, 16) == 8);
+    for (int i = 0; i < 8; ++i) {
+        assert(out[i] == std::to_string(i + 3));
+    }
+    assert(buffer.try_pop_front(out, 16) == 0);
+    assert(buffer.try_push_back(in.data(), 0) == 0);
+    assert(buffer.try_pop_front(out, 0) == 0);
+}
+
+// every value 0 .. producers * perProducer - 1 is pushed once, the consumers add up what they pop;
+// with `batch` > 1 both sides go through the batch operations
+template <typename Buffer>
+void StressTest(int producers, int consumers, long long perProducer, size_t batch) {
+    Buffer buffer(64);
+    long long total = producers * perProducer;
+    std::atomic<long long> sum{0};
+    std::atomic<long long> popped{0};
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&buffer, p, perProducer, batch] {
+            std::vector<long long> items(batch);
+            for (long long i = 0; i < perProducer;) {
+                size_t n = static_cast<size_t>(std::min<long long>(batch, perProducer - i));
+                for (size_t j = 0; j < n; ++j) {
+                    items[j] = p * perProducer + i + j;
+                }
+                size_t pushed = 0;
+                while (pushed < n) {
+                    size_t moved = batch == 1 ? buffer.try_push_back(items[0])
+                                              : buffer.try_push_back(items.data() + pushed, n - pushed);
+                    if (moved == 0) std::this_thread::yield();
+                    pushed += moved;
+                }
+                i += n;
+            }
+        });
+    }
+    for (int c = 0; c < consumers; ++c) {
+        threads.emplace_back([&, batch] {
+            std::vector<long long> items(batch);
+            long long localSum = 0;
+            while (popped.load() < total) {
+                size_t n = batch == 1 ? buffer.try_pop_front(items[0]) : buffer.try_pop_front(items.data(), batch);
+                if (n == 0) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                for (size_t j = 0; j < n; ++j) {
+                    localSum += items[j];
+                }
+                popped.fetch_add(n);
+            }
+            sum.fetch_add(localSum);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    assert(popped.load() == total);
+    assert(sum.load() == total * (total - 1) / 2);
+    assert(buffer.empty());
+}
+
+int main() {
+    TestCapacity();
+
+    SimpleTest<SpscRingBuffer<std::string>>();
+    SimpleTest<MpmcRingBuffer<std::string>>();
+    BatchTest<SpscRingBuffer<std::string>>();
+    BatchTest<MpmcRingBuffer<std::string>>();
+
+    StressTest<SpscRingBuffer<long long>>(1, 1, 200'000, 1);
+    StressTest<SpscRingBuffer<long long>>(1, 1, 200'000, 16);
+    StressTest<MpmcRingBuffer<long long>>(1, 1, 100'000, 1);
+    StressTest<MpmcRingBuffer<long long>>(4, 4, 25'000, 1);
+    StressTest<MpmcRingBuffer<long long>>(4, 4, 25'000, 8);
+    StressTest<MpmcRingBuffer<long long>>(2, 6, 25'000, 5);
+}
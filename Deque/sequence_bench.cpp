@@ -0,0 +1,147 @@
+// Deque against std::deque and List against std::list: pushes and pops at both ends, random
+// access, traversal, insertion and erasure in the middle, copying.
+//
+//     g++ -std=c++17 -O2 -I../List sequence_bench.cpp -o sequence_bench
+//
+// Prints one tab-separated line per (operation, element size, container) with ns per operation,
+// for traversal and copy that is ns per element. Middle insertion and erasure are done at the
+// middle index for the deques and next to one iterator in the middle for the lists.
+
+#include <random>
+#include <vector>
+#include <cstdio>
+#include <string>
+#include <deque>
+#include <list>
+#include <iterator>
+#include <type_traits>
+
+#include "bench.h"
+#include "deque.h"
+#include "list.h"
+
+template <typename Container>
+constexpr bool kRandomAccess = std::is_base_of_v<std::random_access_iterator_tag,
+        typename std::iterator_traits<typename Container::iterator>::iterator_category>;
+
+template <size_t Size, typename Container>
+void BenchContainer(const char* name, size_t count) {
+    using T = typename Container::iterator::value_type;
+    long long sum = 0;
+    Container container;
+    {
+        Timer timer;
+        for (size_t i = 0; i < count; ++i) {
+            container.push_back(T());
+        }
+        Report("push_back", Size, name, timer.nsPer(count));
+    }
+    {
+        Timer timer;
+        for (size_t i = 0; i < count; ++i) {
+            container.pop_back();
+        }
+        Report("pop_back", Size, name, timer.nsPer(count));
+    }
+    {
+        Timer timer;
+        for (size_t i = 0; i < count; ++i) {
+            container.push_front(T());
+        }
+        Report("push_front", Size, name, timer.nsPer(count));
+    }
+    {
+        Timer timer;
+        for (size_t i = 0; i < count; ++i) {
+            container.pop_front();
+        }
+        Report("pop_front", Size, name, timer.nsPer(count));
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        container.push_back(T());
+        container.back().data[0] = static_cast<long long>(i);
+    }
+
+    if constexpr (kRandomAccess<Container>) {
+        std::mt19937 gen(1);
+        std::vector<size_t> indices(count);
+        for (auto& index : indices) {
+            index = gen() % count;
+        }
+        Timer timer;
+        for (size_t index : indices) {
+            sum += container[index].data[0];
+        }
+        Report("random_access", Size, name, timer.nsPer(count));
+    }
+
+    const int kPasses = 10;
+    {
+        Timer timer;
+        for (int pass = 0; pass < kPasses; ++pass) {
+            for (auto& it : container) {
+                sum += it.data[0];
+            }
+        }
+        Report("traverse", Size, name, timer.nsPer(count * kPasses));
+    }
+
+    {
+        Timer timer;
+        Container copy(container);
+        sum += copy.back().data[0];
+        Report("copy", Size, name, timer.nsPer(count));
+    }
+
+    // a deque shifts half of its elements per operation, so it gets fewer of them
+    size_t middleOps = kRandomAccess<Container> ? count / 1000 + 1 : count / 10;
+    {
+        Timer timer;
+        if constexpr (kRandomAccess<Container>) {
+            for (size_t i = 0; i < middleOps; ++i) {
+                container.insert(container.begin() + container.size() / 2, T());
+            }
+        } else {
+            // the new elements go before `middle`, which stays valid
+            auto middle = std::next(container.begin(), count / 2);
+            for (size_t i = 0; i < middleOps; ++i) {
+                container.insert(middle, T());
+            }
+        }
+        Report("insert_middle", Size, name, timer.nsPer(middleOps));
+    }
+    {
+        Timer timer;
+        if constexpr (kRandomAccess<Container>) {
+            for (size_t i = 0; i < middleOps; ++i) {
+                container.erase(container.begin() + container.size() / 2);
+            }
+        } else {
+            auto middle = std::next(container.begin(), count / 2);
+            for (size_t i = 0; i < middleOps; ++i) {
+                middle = container.erase(middle);
+            }
+        }
+        Report("erase_middle", Size, name, timer.nsPer(middleOps));
+    }
+
+    if (sum == 42) std::printf("\n");
+}
+
+template <size_t Size>
+void BenchSize(size_t count) {
+    using T = Object<Size>;
+    BenchContainer<Size, Deque<T>>("Deque", count);
+    BenchContainer<Size, std::deque<T>>("std::deque", count);
+    BenchContainer<Size, List<T>>("List", count);
+    BenchContainer<Size, std::list<T>>("std::list", count);
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::stoul(argv[1]) : 1'000'000;
+    std::printf("operation\tsize\tcontainer\tns/op\n");
+    BenchSize<8>(count);
+    BenchSize<32>(count);
+    BenchSize<128>(count / 4);
+}
@@ -4,6 +4,16 @@
 #include <vector>
 #include <iterator>
 #include <limits>
+#include <tuple>
+#include <utility>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 template <typename T, typename Alloc = std::allocator<T>>
 class List {
@@ -57,7 +67,7 @@ public:
         constructBuf();
     }
 
-    List(size_t n, const Alloc& alloc = Alloc()): alloc_(alloc) {
+    List(size_t n, const Alloc& alloc = Alloc()): alloc_(alloc), allocNode_(alloc) {
         constructBuf();
         size_ = n;
         for (size_t i = 0; i < n; ++i) {
@@ -82,7 +92,7 @@ public:
         }
     }
 
-    List(List&& list) {
+    List(List&& list): alloc_(list.alloc_), allocNode_(list.allocNode_) {
         constructBuf();
         swap(list);
     }
@@ -349,35 +359,266 @@ public:
     }
 };
 
+// Storage layouts of UnorderedMap.
+//
+// NodeLayout keeps every entry in a List node and indexes the nodes with a table of list
+// iterators: iterators and references survive rehashing, iteration follows insertion order.
+struct NodeLayout {};
+
+// FlatLayout keeps the entries inline in an open-addressing table (Swiss table): a lookup reads
+// a group of control bytes and compares keys only in slots whose 7-bit hash fingerprint matches.
+// Growing the table moves the entries, so it invalidates iterators and references, and a
+// traversal costs the capacity of the table rather than its size. Iterators are bidirectional
+// like the node ones; stepping back scans the control bytes one at a time.
+struct FlatLayout {};
+
+namespace detail {
+
+// A control byte of a flat table holds the fingerprint of a full slot or one of these markers.
+using ctrl_t = signed char;
+constexpr ctrl_t kCtrlEmpty = -128;
+constexpr ctrl_t kCtrlDeleted = -2;
+constexpr ctrl_t kCtrlSentinel = -1;
+
+// a group of control bytes is one SSE2 register, or one 64-bit word without SSE2
+#if defined(__SSE2__)
+constexpr size_t kGroupWidth = 16;
+#else
+constexpr size_t kGroupWidth = 8;
+#endif
+
+// control bytes of a table without slots: probing it meets an empty slot at once
+inline const ctrl_t kEmptyGroup[16] = {
+        kCtrlSentinel, kCtrlEmpty, kCtrlEmpty, kCtrlEmpty, kCtrlEmpty, kCtrlEmpty, kCtrlEmpty, kCtrlEmpty,
+        kCtrlEmpty, kCtrlEmpty, kCtrlEmpty, kCtrlEmpty, kCtrlEmpty, kCtrlEmpty, kCtrlEmpty, kCtrlEmpty};
+
+inline void prefetch(const void* address) {
+#if defined(__GNUC__)
+    __builtin_prefetch(address);
+#else
+    (void)address;
+#endif
+}
+
+inline bool isFull(ctrl_t ctrl) {
+    return ctrl >= 0;
+}
+
+inline size_t countTrailingZeros(uint64_t mask) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(mask);
+#else
+    size_t i = 0;
+    while ((mask & 1) == 0) {
+        mask >>= 1;
+        ++i;
+    }
+    return i;
+#endif
+}
+
+// slots of a group that matched, slot i owns bits [i << Shift, (i + 1) << Shift)
+template <typename T, size_t Shift>
+class BitMask {
+    T mask_;
+
+public:
+    explicit BitMask(T mask): mask_(mask) {}
+
+    explicit operator bool() const {
+        return mask_ != 0;
+    }
+
+    size_t lowest() const {
+        return countTrailingZeros(mask_) >> Shift;
+    }
+
+    void clearLowest() {
+        mask_ &= mask_ - 1;
+    }
+};
+
+#if defined(__SSE2__)
+
+// kGroupWidth control bytes matched with one vector comparison, bit i tells about slot i
+class Group {
+    __m128i ctrl_;
+
+    uint32_t emptyOrDeletedBits() const {
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(kCtrlSentinel), ctrl_)));
+    }
+
+public:
+    using Mask = BitMask<uint32_t, 0>;
+
+    explicit Group(const ctrl_t* pos): ctrl_(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pos))) {}
+
+    Mask match(ctrl_t fingerprint) const {
+        return Mask(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(fingerprint), ctrl_))));
+    }
+
+    Mask matchEmpty() const {
+        return match(kCtrlEmpty);
+    }
+
+    Mask matchEmptyOrDeleted() const {
+        return Mask(emptyOrDeletedBits());
+    }
+
+    // how many slots from the start of the group are empty or deleted
+    size_t countLeadingEmptyOrDeleted() const {
+        return countTrailingZeros(~emptyOrDeletedBits());
+    }
+};
+
+#else
+
+// kGroupWidth control bytes matched all at once with word arithmetic, the high bit of byte i
+// tells about slot i. match may also report a slot that does not match, which only costs a key
+// comparison; the empty and deleted markers are told apart exactly.
+class Group {
+    static constexpr uint64_t kLsbs = 0x0101010101010101ULL;
+    static constexpr uint64_t kMsbs = 0x8080808080808080ULL;
+
+    uint64_t ctrl_;
+
+public:
+    using Mask = BitMask<uint64_t, 3>;
+
+    explicit Group(const ctrl_t* pos) {
+        std::memcpy(&ctrl_, pos, sizeof(ctrl_));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        ctrl_ = __builtin_bswap64(ctrl_);
+#endif
+    }
+
+    Mask match(ctrl_t fingerprint) const {
+        uint64_t x = ctrl_ ^ (kLsbs * static_cast<unsigned char>(fingerprint));
+        return Mask((x - kLsbs) & ~x & kMsbs);
+    }
+
+    // empty is the only marker with the high bit set and bit 6 clear
+    Mask matchEmpty() const {
+        return Mask(ctrl_ & ~(ctrl_ << 6) & kMsbs);
+    }
+
+    // the sentinel is the only marker with bit 0 set
+    Mask matchEmptyOrDeleted() const {
+        return Mask(ctrl_ & ~(ctrl_ << 7) & kMsbs);
+    }
+
+    // how many slots from the start of the group are empty or deleted: bit 0 of a byte is set
+    // for those, the other bits are filled in so that adding 1 carries through all of them
+    size_t countLeadingEmptyOrDeleted() const {
+        constexpr uint64_t kGaps = 0x00FEFEFEFEFEFEFEULL;
+        return (countTrailingZeros(((~ctrl_ & (ctrl_ >> 7)) | kGaps) + 1) + 7) >> 3;
+    }
+};
+
+#endif
+
+// spreads every bit of the hash over the whole word (MurmurHash3 finalizer)
+inline size_t mixHash(size_t hash) {
+    uint64_t h = hash;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return static_cast<size_t>(h);
+}
+
+// What UnorderedMap expects from Hash: equal keys hash equally and unequal keys rarely share a
+// value. The bits need not be spread, every hash is mixed before use, so std::hash<int> returning
+// the key itself is as good as a strong hash and sequential ids do not cluster. A Hash whose
+// values are already uniform in every bit may declare `using is_avalanching = void;` to skip
+// the mixing.
+template <typename Hash, typename = void>
+struct IsAvalanching: std::false_type {};
+
+template <typename Hash>
+struct IsAvalanching<Hash, std::void_t<typename Hash::is_avalanching>>: std::true_type {};
+
+template <typename Hash>
+size_t spreadHash(size_t hash) {
+    if constexpr (IsAvalanching<Hash>::value) {
+        return hash;
+    } else {
+        return mixHash(hash);
+    }
+}
+
+// Lookups accept any key type that Hash and Equal accept if both declare
+// `using is_transparent = void;`, so that a map with std::string keys can be searched with a
+// std::string_view without building a string; otherwise the key is converted to Key first.
+template <typename Hash, typename Equal, typename = void>
+struct IsTransparent: std::false_type {};
+
+template <typename Hash, typename Equal>
+struct IsTransparent<Hash, Equal, std::void_t<typename Hash::is_transparent, typename Equal::is_transparent>>:
+    std::true_type {};
+
+// enables a member template taking the lookup key K only for transparent Hash and Equal
+template <typename Hash, typename Equal, typename K>
+using EnableTransparent = std::enable_if_t<IsTransparent<Hash, Equal>::value, K>;
+
+// Tables have a power-of-two number of positions: the position of a spread hash is its upper
+// bits under a mask, its fingerprint the lowest 7 bits.
+inline size_t hashPosition(size_t hash, size_t mask) {
+    return (hash >> 7) & mask;
+}
+
+inline ctrl_t hashFingerprint(size_t hash) {
+    return static_cast<ctrl_t>(hash & 0x7f);
+}
+
+inline size_t roundUpToPowerOfTwo(size_t n) {
+    size_t result = 1;
+    while (result < n) {
+        result *= 2;
+    }
+    return result;
+}
+
+} // namespace detail
+
 template <
         typename Key,
         typename Value,
         typename Hash = std::hash<Key>,
         typename Equal = std::equal_to<Key>,
-        typename Alloc = std::allocator<std::pair<const Key, Value>>>
+        typename Alloc = std::allocator<std::pair<const Key, Value>>,
+        typename Layout = NodeLayout>
 class UnorderedMap {
-    static size_t hashFn(const Key& key) {
+    template <typename K>
+    static size_t hashFn(const K& key) {
         static Hash hash;
         return hash(key);
     }
 
-    static bool equalFn(const Key& a, const Key& b) {
+    template <typename A, typename B>
+    static bool equalFn(const A& a, const B& b) {
         static Equal equal;
         return equal(a, b);
     }
 
-    constexpr static size_t kInitialBucketCount = 2000;
-    constexpr static size_t kMaxSearchDist = 20;
+    constexpr static size_t kInitialBucketCount = 2048;
+    // buckets looked at from the home bucket of a key, a whole number of groups; a table gets a
+    // longer distance only when keys with equal hashes do not fit into a shorter one
+    constexpr static size_t kInitialSearchDist = 32;
+
+    using ctrl_t = detail::ctrl_t;
+    constexpr static size_t kGroupWidth = detail::kGroupWidth;
 
     using NodeType = std::pair<const Key, Value>;
     using NodeTypeAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<NodeType>;
 
     using ListIterator = typename List<NodeType, NodeTypeAlloc>::iterator;
     using ListIteratorAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<ListIterator>;
+    using CtrlAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<ctrl_t>;
 
     Alloc alloc_;
     using Traits = std::allocator_traits<Alloc>;
-    std::vector<ListIterator, ListIteratorAlloc> hashTable_;
     List<NodeType, NodeTypeAlloc> list_;
 
     double maxLoadFactor_ = 0.2;
@@ -385,109 +626,342 @@ class UnorderedMap {
     template<bool isConst>
     using IteratorImpl = typename List<NodeType, NodeTypeAlloc>::template iterator_impl<isConst>;
 
-    void rehash() {
-        bool correct = true;
-        size_t count = hashTable_.size();
-        hashTable_.assign(count, ListIterator());
-        for (auto it = list_.begin(); it != list_.end() && correct; ++it) {
-            size_t hashIndex = bucketIndex(it->first);
-            for (size_t i = 0; i < kMaxSearchDist; ++i) {
-                if (!hashTableElem(i + hashIndex)) {
-                    hashTableElem(i + hashIndex) = it;
-                    break;
-                } else if (i == kMaxSearchDist - 1) {
-                    correct = false;
+    template <typename K>
+    static size_t hashOf(const K& key) {
+        return detail::spreadHash<Hash>(hashFn(key));
+    }
+
+    static ctrl_t fingerprint(size_t hash) {
+        return detail::hashFingerprint(hash);
+    }
+
+    // Buckets of list iterators with a control byte per bucket as in the flat layout, then copies
+    // of the first kGroupWidth - 1 of them, so that a group can be read at any bucket; misses are
+    // decided on the control bytes without touching nodes. The number of buckets is a power of two.
+    //
+    // Only buckets marked full are read, so the buckets are left unfilled when the table is made and
+    // its pages are touched as elements arrive; list iterators are trivially destructible.
+    class BucketTable {
+    private:
+        using TraitsIterator = std::allocator_traits<ListIteratorAlloc>;
+
+        ListIteratorAlloc alloc_;
+        ListIterator* buckets_ = nullptr;
+        size_t size_ = 0;
+        size_t searchDist_ = kInitialSearchDist;
+        std::vector<ctrl_t, CtrlAlloc> ctrl_;
+
+        size_t bucketIndex(size_t hash) const {
+            return detail::hashPosition(hash, size_ - 1);
+        }
+
+        size_t wrap(size_t index) const {
+            return index & (size_ - 1);
+        }
+
+        void setCtrl(size_t i, ctrl_t ctrl) {
+            ctrl_[i] = ctrl;
+            if (i < kGroupWidth - 1) ctrl_[size_ + i] = ctrl;
+        }
+
+    public:
+        explicit BucketTable(const Alloc& alloc): alloc_(alloc), ctrl_(alloc) {}
+
+        BucketTable(BucketTable&& that) noexcept:
+            alloc_(that.alloc_),
+            buckets_(std::exchange(that.buckets_, nullptr)),
+            size_(std::exchange(that.size_, 0)),
+            searchDist_(that.searchDist_),
+            ctrl_(std::move(that.ctrl_)) {}
+
+        BucketTable& operator=(BucketTable&& that) noexcept {
+            release();
+            alloc_ = that.alloc_;
+            buckets_ = std::exchange(that.buckets_, nullptr);
+            size_ = std::exchange(that.size_, 0);
+            searchDist_ = that.searchDist_;
+            ctrl_ = std::move(that.ctrl_);
+            return *this;
+        }
+
+        ~BucketTable() {
+            release();
+        }
+
+        size_t size() const {
+            return size_;
+        }
+
+        size_t searchDist() const {
+            return searchDist_;
+        }
+
+        // empties the table and gives it `count` buckets, a key is looked for up to searchDist
+        // buckets from its home one
+        void reset(size_t count, size_t searchDist = kInitialSearchDist) {
+            searchDist_ = std::min(searchDist, count);
+            if (count != size_ && size_ != 0) release();
+            if (size_ == 0) {
+                buckets_ = TraitsIterator::allocate(alloc_, count);
+                size_ = count;
+                // a table without buckets has only the empty bytes filled in by prepare()
+                ctrl_.resize(count + kGroupWidth - 1, detail::kCtrlEmpty);
+            } else {
+                ctrl_.assign(count + kGroupWidth - 1, detail::kCtrlEmpty);
+            }
+        }
+
+        // fills up to `step` more control bytes of a table without buckets ahead of reset(count)
+        void prepare(size_t count, size_t step) {
+            size_t bytes = count + kGroupWidth - 1;
+            if (ctrl_.capacity() < bytes) {
+                ctrl_.clear();
+                ctrl_.reserve(bytes);
+            }
+            if (ctrl_.size() < bytes) {
+                ctrl_.insert(ctrl_.end(), std::min(step, bytes - ctrl_.size()), detail::kCtrlEmpty);
+            }
+        }
+
+        // frees the memory, the table has no buckets afterwards
+        void release() {
+            if (buckets_ != nullptr) {
+                TraitsIterator::deallocate(alloc_, buckets_, size_);
+            }
+            buckets_ = nullptr;
+            size_ = 0;
+            decltype(ctrl_)(ctrl_.get_allocator()).swap(ctrl_);
+        }
+
+        bool isFull(size_t i) const {
+            return detail::isFull(ctrl_[i]);
+        }
+
+        ListIterator operator[](size_t i) const {
+            return buckets_[i];
+        }
+
+        // bucket of the element with this key, size() if there is none
+        template <typename K>
+        size_t find(const K& key, size_t hash) const {
+            if (size_ == 0) return 0;
+            size_t home = bucketIndex(hash);
+            // a hit is most often in the home bucket, load it while the control bytes are matched
+            detail::prefetch(&buckets_[home]);
+            for (size_t dist = 0; dist < searchDist_; dist += kGroupWidth) {
+                size_t pos = wrap(home + dist);
+                detail::Group group(ctrl_.data() + pos);
+                for (auto mask = group.match(fingerprint(hash)); mask; mask.clearLowest()) {
+                    size_t i = wrap(pos + mask.lowest());
+                    if (equalFn(key, buckets_[i]->first)) return i;
                 }
+                if (group.matchEmpty()) break;
             }
+            return size_;
+        }
+
+        // puts iter into the first free bucket near its home one, false if there is none
+        bool place(ListIterator iter, size_t hash) {
+            if (size_ == 0) return false;
+            size_t home = bucketIndex(hash);
+            for (size_t dist = 0; dist < searchDist_; dist += kGroupWidth) {
+                size_t pos = wrap(home + dist);
+                auto mask = detail::Group(ctrl_.data() + pos).matchEmptyOrDeleted();
+                if (mask) {
+                    size_t i = wrap(pos + mask.lowest());
+                    TraitsIterator::construct(alloc_, buckets_ + i, iter);
+                    setCtrl(i, fingerprint(hash));
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // a deleted mark keeps probing going past the bucket
+        void erase(size_t i) {
+            setCtrl(i, detail::kCtrlDeleted);
         }
-        if (!correct) {
-            reserve(count * 2);
+    };
+
+    // Growing moves the iterators to a table twice as large a few buckets at a time: every
+    // mutating operation migrates the next kMigrationStep buckets of oldTable_, lookups try table_
+    // and then oldTable_ until all of them are migrated. Migrated buckets are marked deleted, so an
+    // element is in one of the tables. A table of size n grows with about n * maxLoadFactor_
+    // elements and the next one has room for as many more, so the migration is over long before it
+    // has to grow again for any load factor above 1 / kMigrationStep; otherwise the rest of it is
+    // done at once.
+    //
+    // Filling the control bytes of a large table takes long as well, so the ones of the table to
+    // grow into are filled in ahead of time, kPrepareStep of them per operation, in nextTable_.
+    constexpr static size_t kMigrationStep = 16;
+    constexpr static size_t kPrepareStep = 64;
+
+    BucketTable table_;
+    BucketTable oldTable_;
+    BucketTable nextTable_;
+    size_t migrated_ = 0; // buckets of oldTable_ before it are migrated
+
+    bool migrating() const {
+        return oldTable_.size() != 0;
+    }
+
+    // Places every element into a new table of at least `count` buckets. An element that finds no
+    // free bucket near its home one has mostly been unlucky, and doubling the table spreads the
+    // elements out; but more than kInitialSearchDist keys with equal hashes collide in a table of
+    // any size, so once the table has a few times the buckets the load factor asks for, it is the
+    // search distance that doubles.
+    void rehash(size_t count, size_t searchDist = kInitialSearchDist) {
+        oldTable_.release();
+        migrated_ = 0;
+        count = std::max(count, kInitialBucketCount);
+        while (!placeAll(count, searchDist)) {
+            if (count < maxUsefulBucketCount() || searchDist >= count) {
+                count *= 2;
+            } else {
+                searchDist *= 2;
+            }
         }
     }
 
-    size_t bucketIndex(const Key& key) {
-        size_t ans = hashFn(key) % hashTable_.size();
-        return ans;
+    size_t maxUsefulBucketCount() const {
+        return 4 * detail::roundUpToPowerOfTwo(static_cast<size_t>(list_.size() / maxLoadFactor_) + 1);
     }
 
-    IteratorImpl<false> findPlace(const Key& key) {
-        size_t hashIndex = bucketIndex(key);
+    // after an element found no free bucket within the search distance
+    void rehashAfterFailedPlace() {
+        if (table_.size() < maxUsefulBucketCount()) {
+            rehash(table_.size() * 2);
+        } else {
+            rehash(table_.size(), table_.searchDist() * 2);
+        }
+    }
 
-        for (size_t i = 0; i < kMaxSearchDist; ++i) {
-            if (!hashTable_[(hashIndex + i) % hashTable_.size()]) {
-                return list_.end();
-            }
-            if (equalFn(key, hashTable_[(hashIndex + i) % hashTable_.size()]->first)) {
-                return hashTableElem(hashIndex + i);
-            }
+    bool placeAll(size_t count, size_t searchDist) {
+        table_.reset(count, searchDist);
+        for (auto it = list_.begin(); it != list_.end(); ++it) {
+            if (!table_.place(it, hashOf(it->first))) return false;
         }
-        return list_.end();
+        return true;
     }
 
-    IteratorImpl<true> findPlace(const Key& key) const {
-        size_t hashIndex = bucketIndex(key);
+    void startGrowth() {
+        if (migrating() && migrate(oldTable_.size())) return;
+        size_t count = table_.size() * 2;
+        std::swap(oldTable_, table_);
+        std::swap(table_, nextTable_);
+        // the keys that needed a longer search distance will need it in the bigger table as well
+        table_.reset(count, oldTable_.searchDist());
+        migrated_ = 0;
+    }
 
-        for (size_t i = 0; i < kMaxSearchDist; ++i) {
-            if (!hashTable_[(hashIndex + i) % hashTable_.size()]) {
-                return list_.end();
-            }
-            if (equalFn(key, hashTableElem(hashIndex + i)->first)) {
-                return hashTable_[(hashIndex + i) % hashTable_.size()];
+    // the part of growing done by every mutating operation, returns whether all iterators were
+    // placed again
+    bool growthStep() {
+        if (migrate(kMigrationStep)) return true;
+        nextTable_.prepare(table_.size() * 2, kPrepareStep);
+        return false;
+    }
+
+    // returns whether some iterator did not fit and all of them were placed again
+    bool migrate(size_t steps) {
+        if (!migrating()) return false;
+        size_t last = std::min(migrated_ + steps, oldTable_.size());
+        // the nodes are scattered, their keys are loaded together rather than one after another
+        for (size_t i = migrated_; i < last; ++i) {
+            if (oldTable_.isFull(i)) detail::prefetch(&*oldTable_[i]);
+        }
+        for (; migrated_ < last; ++migrated_) {
+            if (!oldTable_.isFull(migrated_)) continue;
+            ListIterator iter = oldTable_[migrated_];
+            if (!table_.place(iter, hashOf(iter->first))) {
+                rehashAfterFailedPlace();
+                return true;
             }
+            oldTable_.erase(migrated_);
+        }
+        if (migrated_ == oldTable_.size()) {
+            oldTable_.release();
+            migrated_ = 0;
         }
-        return list_.end();
+        return false;
     }
 
-    bool addIterator(IteratorImpl<false> iter) {
-        size_t hashIndex = bucketIndex(iter->first);
-        bool inserted = false;
-        while (!inserted) {
-            for (size_t i = 0; i < kMaxSearchDist; ++i) {
-                if (!hashTable_[(hashIndex + i) % hashTable_.size()]) {
-                    hashTable_[(hashIndex + i) % hashTable_.size()] = iter;
-                    inserted = true;
-                    break;
-                }
-            }
-            if (!inserted) {
-                reserve(hashTable_.size() * 2);
-            }
+    // the table holding the element with this key and its bucket there, nullptr if there is none
+    template <typename Table, typename K>
+    static std::pair<Table*, size_t> locate(Table& table, Table& oldTable, const K& key, size_t hash) {
+        size_t i = table.find(key, hash);
+        if (i != table.size()) return {&table, i};
+        if (oldTable.size() != 0) {
+            i = oldTable.find(key, hash);
+            if (i != oldTable.size()) return {&oldTable, i};
         }
+        return {nullptr, 0};
+    }
+
+    template <typename K>
+    IteratorImpl<false> findPlace(const K& key, size_t hash) {
+        auto [table, i] = locate(table_, oldTable_, key, hash);
+        return table == nullptr ? list_.end() : (*table)[i];
+    }
+
+    template <typename K>
+    IteratorImpl<true> findPlace(const K& key, size_t hash) const {
+        auto [table, i] = locate(table_, oldTable_, key, hash);
+        return table == nullptr ? list_.end() : (*table)[i];
+    }
+
+    void addIterator(IteratorImpl<false> iter, size_t hash) {
+        if (!table_.place(iter, hash)) {
+            // iter is in list_ already, the rehash places it with the others
+            rehashAfterFailedPlace();
+            return;
+        }
+        if (growthStep()) return;
         if (load_factor() > max_load_factor()) {
-            reserve(hashTable_.size() * 2);
-            return true;
+            startGrowth();
         }
-        return false;
     }
 
-    decltype(auto) hashTableElem(size_t i) {
-        return hashTable_[i % hashTable_.size()];
+    // builds NodeType(args...) for `key` unless the key is already there
+    template <typename K, typename... Args>
+    std::pair<IteratorImpl<false>, bool> emplaceKey(const K& key, size_t hash, Args&&... args) {
+        IteratorImpl<false> it = findPlace(key, hash);
+        if (it != list_.end()) return {it, false};
+        it = list_.emplace(list_.end(), std::forward<Args>(args)...);
+        addIterator(it, hash);
+        return {it, true};
     }
 
 public:
     using Iterator = IteratorImpl<false>;
     using ConstIterator = IteratorImpl<true>;
 
-    UnorderedMap(Alloc alloc = Alloc()): alloc_(alloc), hashTable_(alloc_), list_(alloc_) {
-        reserve(kInitialBucketCount);
+    UnorderedMap(Alloc alloc = Alloc()):
+        alloc_(alloc),
+        list_(alloc_),
+        table_(alloc_),
+        oldTable_(alloc_),
+        nextTable_(alloc_)
+    {
+        rehash(kInitialBucketCount);
     }
 
     UnorderedMap(const UnorderedMap& that):
         alloc_(Traits::select_on_container_copy_construction(that.alloc_)),
-        hashTable_(alloc_),
-        list_(that.list_)
+        list_(that.list_),
+        table_(alloc_),
+        oldTable_(alloc_),
+        nextTable_(alloc_)
     {
-        reserve(that.hashTable_.size());
-        rehash();
+        rehash(that.table_.size(), that.table_.searchDist());
     }
 
     UnorderedMap& operator=(UnorderedMap& that) {
         list_ = that.list_;
-        hashTable_ = that.hashTable_;
         if (Traits::propagate_on_container_copy_assignment::value) {
             alloc_ = that.alloc_;
         }
-        rehash();
+        rehash(that.table_.size(), that.table_.searchDist());
         return *this;
     }
 
@@ -495,7 +969,10 @@ public:
 
     UnorderedMap& operator=(UnorderedMap&& that) {
         list_ = std::move(that.list_);
-        hashTable_ = std::move(that.hashTable_);
+        table_ = std::move(that.table_);
+        oldTable_ = std::move(that.oldTable_);
+        nextTable_ = std::move(that.nextTable_);
+        migrated_ = that.migrated_;
         if (Traits::propagate_on_container_move_assignment::value) {
             alloc_ = std::move(that.alloc_);
         }
@@ -503,14 +980,18 @@ public:
     }
 
     Value& operator[](const Key& key) {
-        Iterator it = findPlace(key);
-        if (it == list_.end()) {
-            it = list_.emplace(it, key, Value());
-            if (addIterator(it)) {
-                return find(key)->second;
-            }
-        }
-        return it->second;
+        return try_emplace(key).first->second;
+    }
+
+    Value& operator[](Key&& key) {
+        return try_emplace(std::move(key)).first->second;
+    }
+
+    // Key is built from `key` only if it is not there yet
+    template <typename K, typename = detail::EnableTransparent<Hash, Equal, K>>
+    Value& operator[](K&& key) {
+        return emplaceKey(key, hashOf(key), std::piecewise_construct,
+                          std::forward_as_tuple(std::forward<K>(key)), std::tuple<>()).first->second;
     }
 
     Value& at(const Key& key) {
@@ -529,16 +1010,66 @@ public:
         return it->second;
     }
 
+    template <typename K, typename = detail::EnableTransparent<Hash, Equal, K>>
+    Value& at(const K& key) {
+        auto it = find(key);
+        if (it == end()) {
+            throw std::out_of_range("no such element");
+        }
+        return it->second;
+    }
+
+    template <typename K, typename = detail::EnableTransparent<Hash, Equal, K>>
+    const Value& at(const K& key) const {
+        auto it = find(key);
+        if (it == end()) {
+            throw std::out_of_range("no such element");
+        }
+        return it->second;
+    }
+
     size_t size() const {
         return list_.size();
     }
 
     std::pair<Iterator, bool> insert(const NodeType& node) {
-        return emplace(node);
+        return emplaceKey(node.first, hashOf(node.first), node);
     }
 
     std::pair<Iterator, bool> insert(NodeType&& node) {
-        return emplace(std::move(const_cast<Key&>(node.first)), std::move(node.second));
+        return emplaceKey(node.first, hashOf(node.first), std::move(const_cast<Key&>(node.first)),
+                          std::move(node.second));
+    }
+
+    // the value is built from args only if the key is not there yet, args are untouched otherwise
+    template <typename... Args>
+    std::pair<Iterator, bool> try_emplace(const Key& key, Args&&... args) {
+        return emplaceKey(key, hashOf(key), std::piecewise_construct, std::forward_as_tuple(key),
+                          std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+
+    template <typename... Args>
+    std::pair<Iterator, bool> try_emplace(Key&& key, Args&&... args) {
+        return emplaceKey(key, hashOf(key), std::piecewise_construct, std::forward_as_tuple(std::move(key)),
+                          std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+
+    template <typename M>
+    std::pair<Iterator, bool> insert_or_assign(const Key& key, M&& value) {
+        auto result = try_emplace(key, std::forward<M>(value));
+        if (!result.second) {
+            result.first->second = std::forward<M>(value);
+        }
+        return result;
+    }
+
+    template <typename M>
+    std::pair<Iterator, bool> insert_or_assign(Key&& key, M&& value) {
+        auto result = try_emplace(std::move(key), std::forward<M>(value));
+        if (!result.second) {
+            result.first->second = std::forward<M>(value);
+        }
+        return result;
     }
 
     template <typename InputIt>
@@ -548,32 +1079,26 @@ public:
         }
     }
 
+    // the key is known only once the element is built, so a node is made before the lookup
     template <typename... Args>
     std::pair<Iterator, bool> emplace(Args&&... args) {
         Iterator place = list_.emplace(list_.end(), std::forward<Args>(args)...);
-        Iterator it = findPlace(place->first);
-        if (it != list_.end() && equalFn(place->first, it->first)) {
-            if (it == place) {
-                return {it, true};
-            } else {
-                list_.pop_back();
-                return {it, false};
-            }
+        size_t hash = hashOf(place->first);
+        Iterator it = findPlace(place->first, hash);
+        if (it != list_.end()) {
+            list_.pop_back();
+            return {it, false};
         }
-        addIterator(place);
+        addIterator(place, hash);
         return {place, true};
     }
 
     void erase(Iterator elem) {
         if (elem == list_.end()) return;
-        size_t hashIndex = bucketIndex(elem->first);
-        for (size_t i = 0; i < kMaxSearchDist; ++i) {
-            if (hashTableElem(hashIndex + i) == elem) {
-                hashTableElem(hashIndex + i) = Iterator();
-                break;
-            }
-        }
+        auto [table, i] = locate(table_, oldTable_, elem->first, hashOf(elem->first));
+        if (table != nullptr) table->erase(i);
         list_.erase(elem);
+        growthStep();
     }
 
     void erase(Iterator begin, Iterator end) {
@@ -586,25 +1111,51 @@ public:
     }
 
     Iterator find(const Key& key) {
-        Iterator it = findPlace(key);
-        if (it == list_.end() || !equalFn(it->first, key)) {
-            return end();
-        }
-        return Iterator(it);
+        return findPlace(key, hashOf(key));
     }
 
     ConstIterator find(const Key& key) const {
-        ConstIterator it = findPlace(key);
-        if (it == list_.end() || !equalFn(it->first, key)) {
-            return cend();
-        }
-        return ConstIterator(it);
+        return findPlace(key, hashOf(key));
+    }
+
+    // `hash` is hash_function()(key), computed once for a key looked up in several maps
+    Iterator find(const Key& key, size_t hash) {
+        return findPlace(key, detail::spreadHash<Hash>(hash));
+    }
+
+    ConstIterator find(const Key& key, size_t hash) const {
+        return findPlace(key, detail::spreadHash<Hash>(hash));
+    }
+
+    template <typename K, typename = detail::EnableTransparent<Hash, Equal, K>>
+    Iterator find(const K& key) {
+        return findPlace(key, hashOf(key));
+    }
+
+    template <typename K, typename = detail::EnableTransparent<Hash, Equal, K>>
+    ConstIterator find(const K& key) const {
+        return findPlace(key, hashOf(key));
+    }
+
+    template <typename K, typename = detail::EnableTransparent<Hash, Equal, K>>
+    Iterator find(const K& key, size_t hash) {
+        return findPlace(key, detail::spreadHash<Hash>(hash));
+    }
+
+    template <typename K, typename = detail::EnableTransparent<Hash, Equal, K>>
+    ConstIterator find(const K& key, size_t hash) const {
+        return findPlace(key, detail::spreadHash<Hash>(hash));
+    }
+
+    Hash hash_function() const {
+        return Hash();
     }
 
+    // the number of buckets is rounded up to a power of two; unlike growing on insertion this
+    // places all elements at once, so reserving up front keeps rehashing off the hot path
     void reserve(size_t size) {
-        if (size <= hashTable_.size()) return;
-        hashTable_.resize(size);
-        if (!list_.empty()) rehash();
+        if (size <= table_.size()) return;
+        rehash(detail::roundUpToPowerOfTwo(size));
     }
 
     constexpr size_t max_size() const {
@@ -612,7 +1163,7 @@ public:
     }
 
     double load_factor() const {
-        return static_cast<double>(list_.size()) / hashTable_.size();
+        return static_cast<double>(list_.size()) / table_.size();
     }
 
     double max_load_factor() const {
@@ -622,7 +1173,7 @@ public:
     void max_load_factor(double factor) {
         maxLoadFactor_ = factor;
         if (load_factor() > factor) {
-            reserve(hashTable_.size() * 2);
+            reserve(static_cast<size_t>(list_.size() / factor) + 1);
         }
     }
 
@@ -650,3 +1201,582 @@ public:
         return ConstIterator(list_.end());
     }
 };
+
+// Slots are grouped by the control bytes: ctrl_[i] describes slots_[i], ctrl_[capacity_] is a
+// sentinel that stops iteration, and the kGroupWidth - 1 bytes after it repeat the first ones, so
+// a group can be read at any position without wrapping. The capacity is 2^k - 1 and groups are
+// probed at triangular offsets from the home position, which visits every group of the table.
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+class UnorderedMap<Key, Value, Hash, Equal, Alloc, FlatLayout> {
+    using ctrl_t = detail::ctrl_t;
+    static constexpr size_t kGroupWidth = detail::kGroupWidth;
+    static constexpr size_t kMinCapacity = kGroupWidth - 1;
+
+    template <typename K>
+    static size_t hashFn(const K& key) {
+        static Hash hash;
+        return hash(key);
+    }
+
+    template <typename A, typename B>
+    static bool equalFn(const A& a, const B& b) {
+        static Equal equal;
+        return equal(a, b);
+    }
+
+    using NodeType = std::pair<const Key, Value>;
+    using NodeTypeAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<NodeType>;
+    using Traits = std::allocator_traits<NodeTypeAlloc>;
+    using CtrlAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<ctrl_t>;
+    using TraitsCtrl = std::allocator_traits<CtrlAlloc>;
+
+    NodeTypeAlloc alloc_;
+    CtrlAlloc allocCtrl_;
+    ctrl_t* ctrl_ = const_cast<ctrl_t*>(detail::kEmptyGroup); // never written while capacity_ is 0
+    NodeType* slots_ = nullptr;
+    size_t capacity_ = 0;
+    size_t size_ = 0;
+    size_t growthLeft_ = 0; // empty slots that can be filled before the table has to grow
+    size_t firstHint_ = 0; // there are no full slots before it
+
+    double maxLoadFactor_ = 0.875;
+
+public:
+    template <bool isConst>
+    class iterator_impl {
+    private:
+        const ctrl_t* ctrl_ = nullptr;
+        NodeType* slot_ = nullptr;
+
+        iterator_impl(const ctrl_t* ctrl, NodeType* slot): ctrl_(ctrl), slot_(slot) {}
+
+        // moves to the first full slot or to the sentinel, a group of free slots at a time
+        void skipFree() {
+            while (*ctrl_ < detail::kCtrlSentinel) {
+                size_t free = detail::Group(ctrl_).countLeadingEmptyOrDeleted();
+                ctrl_ += free;
+                slot_ += free;
+            }
+        }
+
+        template <bool> friend class iterator_impl;
+        friend class UnorderedMap;
+
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = std::conditional_t<isConst, const NodeType, NodeType>;
+        using difference_type = std::ptrdiff_t;
+        using reference = value_type&;
+        using pointer = value_type*;
+
+        iterator_impl() = default;
+
+        operator iterator_impl<true>() const {
+            return iterator_impl<true>(ctrl_, slot_);
+        }
+
+        iterator_impl<isConst>& operator++() {
+            ++ctrl_;
+            ++slot_;
+            skipFree();
+            return *this;
+        }
+
+        iterator_impl<isConst> operator++(int) {
+            auto ans = *this;
+            ++*this;
+            return ans;
+        }
+
+        // moves back to the previous full slot a byte at a time: a group load could read before
+        // the start of the control bytes, and there is always a full slot before a non-begin position
+        iterator_impl<isConst>& operator--() {
+            do {
+                --ctrl_;
+                --slot_;
+            } while (!detail::isFull(*ctrl_));
+            return *this;
+        }
+
+        iterator_impl<isConst> operator--(int) {
+            auto ans = *this;
+            --*this;
+            return ans;
+        }
+
+        reference operator*() const {
+            return *slot_;
+        }
+
+        pointer operator->() const {
+            return slot_;
+        }
+
+        friend bool operator==(const iterator_impl<isConst>& a, const iterator_impl<isConst>& b) {
+            return a.ctrl_ == b.ctrl_;
+        }
+
+        friend bool operator!=(const iterator_impl<isConst>& a, const iterator_impl<isConst>& b) {
+            return !(a == b);
+        }
+    };
+
+    using Iterator = iterator_impl<false>;
+    using ConstIterator = iterator_impl<true>;
+
+private:
+    template <typename K>
+    static size_t hashOf(const K& key) {
+        return detail::spreadHash<Hash>(hashFn(key));
+    }
+
+    static ctrl_t fingerprint(size_t hash) {
+        return detail::hashFingerprint(hash);
+    }
+
+    // capacity_ + 1 is the number of positions, sentinel included
+    size_t homeOffset(size_t hash) const {
+        return detail::hashPosition(hash, capacity_);
+    }
+
+    // how many slots may be taken (by elements or erased marks) before the table grows,
+    // at least one slot stays empty so that probing always stops
+    size_t growthFor(size_t capacity) const {
+        if (capacity == 0) return 0;
+        return std::min(static_cast<size_t>(capacity * maxLoadFactor_), capacity - 1);
+    }
+
+    size_t capacityFor(size_t count) const {
+        size_t capacity = kMinCapacity;
+        while (growthFor(capacity) < count) {
+            capacity = capacity * 2 + 1;
+        }
+        return capacity;
+    }
+
+    void setCtrl(size_t i, ctrl_t ctrl) {
+        ctrl_[i] = ctrl;
+        ctrl_[((i - (kGroupWidth - 1)) & capacity_) + (kGroupWidth - 1)] = ctrl;
+    }
+
+    // slot of the element with this key, capacity_ if there is none
+    template <typename K>
+    size_t findIndex(const K& key, size_t hash) const {
+        size_t offset = homeOffset(hash);
+        for (size_t step = kGroupWidth;; step += kGroupWidth) {
+            detail::Group group(ctrl_ + offset);
+            for (auto mask = group.match(fingerprint(hash)); mask; mask.clearLowest()) {
+                size_t i = (offset + mask.lowest()) & capacity_;
+                if (equalFn(slots_[i].first, key)) return i;
+            }
+            if (group.matchEmpty()) return capacity_;
+            offset = (offset + step) & capacity_;
+        }
+    }
+
+    // first slot on the probe sequence that can take a new element
+    size_t findInsertIndex(size_t hash) const {
+        size_t offset = homeOffset(hash);
+        for (size_t step = kGroupWidth;; step += kGroupWidth) {
+            auto mask = detail::Group(ctrl_ + offset).matchEmptyOrDeleted();
+            if (mask) return (offset + mask.lowest()) & capacity_;
+            offset = (offset + step) & capacity_;
+        }
+    }
+
+    // slot for a new element with this hash, the element is counted by commitInsert once it is built
+    size_t prepareInsert(size_t hash) {
+        if (growthLeft_ == 0) {
+            // erased marks are dropped without growing if they are what fills the table
+            bool fewElements = size_ + 1 <= growthFor(capacity_) / 2;
+            rehash(fewElements ? capacity_ : capacityFor(size_ + 1));
+        }
+        return findInsertIndex(hash);
+    }
+
+    void commitInsert(size_t i, size_t hash) {
+        if (ctrl_[i] == detail::kCtrlEmpty) --growthLeft_;
+        setCtrl(i, fingerprint(hash));
+        ++size_;
+        if (i < firstHint_) firstHint_ = i;
+    }
+
+    // builds NodeType(args...) for `key` unless the key is already there
+    template <typename K, typename... Args>
+    std::pair<Iterator, bool> emplaceKey(const K& key, size_t hash, Args&&... args) {
+        size_t i = findIndex(key, hash);
+        if (i != capacity_) return {iteratorAt(i), false};
+        i = prepareInsert(hash);
+        Traits::construct(alloc_, slots_ + i, std::forward<Args>(args)...);
+        commitInsert(i, hash);
+        return {iteratorAt(i), true};
+    }
+
+    void rehash(size_t capacity) {
+        ctrl_t* ctrl = TraitsCtrl::allocate(allocCtrl_, capacity + kGroupWidth);
+        NodeType* slots = nullptr;
+        try {
+            slots = Traits::allocate(alloc_, capacity);
+        } catch (...) {
+            TraitsCtrl::deallocate(allocCtrl_, ctrl, capacity + kGroupWidth);
+            throw;
+        }
+        std::memset(ctrl, detail::kCtrlEmpty, capacity + kGroupWidth);
+        ctrl[capacity] = detail::kCtrlSentinel;
+
+        ctrl_t* oldCtrl = ctrl_;
+        NodeType* oldSlots = slots_;
+        size_t oldCapacity = capacity_;
+        ctrl_ = ctrl;
+        slots_ = slots;
+        capacity_ = capacity;
+        for (size_t i = 0; i < oldCapacity; ++i) {
+            if (!detail::isFull(oldCtrl[i])) continue;
+            size_t hash = hashOf(oldSlots[i].first);
+            size_t j = findInsertIndex(hash);
+            Traits::construct(alloc_, slots_ + j, std::move(const_cast<Key&>(oldSlots[i].first)),
+                              std::move(oldSlots[i].second));
+            Traits::destroy(alloc_, oldSlots + i);
+            setCtrl(j, fingerprint(hash));
+        }
+        growthLeft_ = growthFor(capacity_) - size_;
+        firstHint_ = 0;
+        deallocate(oldCtrl, oldSlots, oldCapacity);
+    }
+
+    void deallocate(ctrl_t* ctrl, NodeType* slots, size_t capacity) {
+        if (capacity == 0) return;
+        TraitsCtrl::deallocate(allocCtrl_, ctrl, capacity + kGroupWidth);
+        Traits::deallocate(alloc_, slots, capacity);
+    }
+
+    void destroyAll() {
+        for (size_t i = 0; i < capacity_; ++i) {
+            if (detail::isFull(ctrl_[i])) Traits::destroy(alloc_, slots_ + i);
+        }
+        deallocate(ctrl_, slots_, capacity_);
+        ctrl_ = const_cast<ctrl_t*>(detail::kEmptyGroup);
+        slots_ = nullptr;
+        capacity_ = 0;
+        size_ = 0;
+        growthLeft_ = 0;
+        firstHint_ = 0;
+    }
+
+    void swapTables(UnorderedMap& that) noexcept {
+        std::swap(ctrl_, that.ctrl_);
+        std::swap(slots_, that.slots_);
+        std::swap(capacity_, that.capacity_);
+        std::swap(size_, that.size_);
+        std::swap(growthLeft_, that.growthLeft_);
+        std::swap(firstHint_, that.firstHint_);
+        std::swap(maxLoadFactor_, that.maxLoadFactor_);
+    }
+
+    void copyFrom(const UnorderedMap& that) {
+        maxLoadFactor_ = that.maxLoadFactor_;
+        try {
+            reserve(that.size());
+            for (const auto& node : that) {
+                insert(node);
+            }
+        } catch (...) {
+            destroyAll();
+            throw;
+        }
+    }
+
+    // a miss gives capacity_, which is where end() points
+    template <typename K>
+    Iterator findHashed(const K& key, size_t hash) const {
+        return iteratorAt(findIndex(key, hash));
+    }
+
+    Iterator firstFull() const {
+        Iterator it = iteratorAt(firstHint_);
+        it.skipFree();
+        return it;
+    }
+
+    Iterator iteratorAt(size_t i) const {
+        return Iterator(ctrl_ + i, slots_ + i);
+    }
+
+public:
+    UnorderedMap(Alloc alloc = Alloc()): alloc_(alloc), allocCtrl_(alloc) {}
+
+    UnorderedMap(const UnorderedMap& that):
+        alloc_(Traits::select_on_container_copy_construction(that.alloc_)),
+        allocCtrl_(alloc_)
+    {
+        copyFrom(that);
+    }
+
+    UnorderedMap(UnorderedMap&& that) noexcept: alloc_(that.alloc_), allocCtrl_(that.allocCtrl_) {
+        swapTables(that);
+    }
+
+    UnorderedMap& operator=(const UnorderedMap& that) {
+        if (this == &that) return *this;
+        UnorderedMap copy(Traits::propagate_on_container_copy_assignment::value ? that.alloc_ : alloc_);
+        copy.copyFrom(that);
+        swap(copy);
+        return *this;
+    }
+
+    UnorderedMap& operator=(UnorderedMap&& that) noexcept(
+            Traits::propagate_on_container_move_assignment::value || Traits::is_always_equal::value) {
+        if (this == &that) return *this;
+        if constexpr (Traits::propagate_on_container_move_assignment::value || Traits::is_always_equal::value) {
+            UnorderedMap moved(std::move(that));
+            swap(moved);
+        } else {
+            UnorderedMap moved(alloc_);
+            moved.maxLoadFactor_ = that.maxLoadFactor_;
+            moved.reserve(that.size());
+            for (auto& node : that) {
+                moved.insert(std::move(node));
+            }
+            swap(moved);
+        }
+        return *this;
+    }
+
+    ~UnorderedMap() {
+        destroyAll();
+    }
+
+    void swap(UnorderedMap& that) noexcept {
+        std::swap(alloc_, that.alloc_);
+        std::swap(allocCtrl_, that.allocCtrl_);
+        swapTables(that);
+    }
+
+    Value& operator[](const Key& key) {
+        return try_emplace(key).first->second;
+    }
+
+    Value& operator[](Key&& key) {
+        return try_emplace(std::move(key)).first->second;
+    }
+
+    // Key is built from `key` only if it is not there yet
+    template <typename K, typename = detail::EnableTransparent<Hash, Equal, K>>
+    Value& operator[](K&& key) {
+        return emplaceKey(key, hashOf(key), std::piecewise_construct,
+                          std::forward_as_tuple(std::forward<K>(key)), std::tuple<>()).first->second;
+    }
+
+    Value& at(const Key& key) {
+        auto it = find(key);
+        if (it == end()) {
+            throw std::out_of_range("no such element");
+        }
+        return it->second;
+    }
+
+    const Value& at(const Key& key) const {
+        auto it = find(key);
+        if (it == end()) {
+            throw std::out_of_range("no such element");
+        }
+        return it->second;
+    }
+
+    template <typename K, typename = detail::EnableTransparent<Hash, Equal, K>>
+    Value& at(const K& key) {
+        auto it = find(key);
+        if (it == end()) {
+            throw std::out_of_range("no such element");
+        }
+        return it->second;
+    }
+
+    template <typename K, typename = detail::EnableTransparent<Hash, Equal, K>>
+    const Value& at(const K& key) const {
+        auto it = find(key);
+        if (it == end()) {
+            throw std::out_of_range("no such element");
+        }
+        return it->second;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    std::pair<Iterator, bool> insert(const NodeType& node) {
+        return emplaceKey(node.first, hashOf(node.first), node);
+    }
+
+    std::pair<Iterator, bool> insert(NodeType&& node) {
+        return emplaceKey(node.first, hashOf(node.first), std::move(const_cast<Key&>(node.first)),
+                          std::move(node.second));
+    }
+
+    template <typename InputIt>
+    void insert(InputIt begin, InputIt end) {
+        for (auto it = begin; it != end; ++it) {
+            insert(*it);
+        }
+    }
+
+    // the value is built from args only if the key is not there yet, args are untouched otherwise
+    template <typename... Args>
+    std::pair<Iterator, bool> try_emplace(const Key& key, Args&&... args) {
+        return emplaceKey(key, hashOf(key), std::piecewise_construct, std::forward_as_tuple(key),
+                          std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+
+    template <typename... Args>
+    std::pair<Iterator, bool> try_emplace(Key&& key, Args&&... args) {
+        return emplaceKey(key, hashOf(key), std::piecewise_construct, std::forward_as_tuple(std::move(key)),
+                          std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+
+    template <typename M>
+    std::pair<Iterator, bool> insert_or_assign(const Key& key, M&& value) {
+        auto result = try_emplace(key, std::forward<M>(value));
+        if (!result.second) {
+            result.first->second = std::forward<M>(value);
+        }
+        return result;
+    }
+
+    template <typename M>
+    std::pair<Iterator, bool> insert_or_assign(Key&& key, M&& value) {
+        auto result = try_emplace(std::move(key), std::forward<M>(value));
+        if (!result.second) {
+            result.first->second = std::forward<M>(value);
+        }
+        return result;
+    }
+
+    // the key is known only once the element is built, so it is built aside and moved into its slot
+    template <typename... Args>
+    std::pair<Iterator, bool> emplace(Args&&... args) {
+        alignas(NodeType) unsigned char buffer[sizeof(NodeType)];
+        NodeType* node = reinterpret_cast<NodeType*>(buffer);
+        Traits::construct(alloc_, node, std::forward<Args>(args)...);
+        try {
+            auto result = insert(std::move(*node));
+            Traits::destroy(alloc_, node);
+            return result;
+        } catch (...) {
+            Traits::destroy(alloc_, node);
+            throw;
+        }
+    }
+
+    void erase(ConstIterator elem) {
+        if (elem == cend()) return;
+        size_t i = elem.slot_ - slots_;
+        Traits::destroy(alloc_, slots_ + i);
+        setCtrl(i, detail::kCtrlDeleted);
+        --size_;
+        if (i == firstHint_) {
+            ++firstHint_; // keeps erasing from begin() from rescanning the freed prefix
+        }
+    }
+
+    void erase(ConstIterator begin, ConstIterator end) {
+        for (auto it = begin; it != end;) {
+            erase(it++);
+        }
+    }
+
+    Iterator find(const Key& key) {
+        return findHashed(key, hashOf(key));
+    }
+
+    ConstIterator find(const Key& key) const {
+        return findHashed(key, hashOf(key));
+    }
+
+    // `hash` is hash_function()(key), computed once for a key looked up in several maps
+    Iterator find(const Key& key, size_t hash) {
+        return findHashed(key, detail::spreadHash<Hash>(hash));
+    }
+
+    ConstIterator find(const Key& key, size_t hash) const {
+        return findHashed(key, detail::spreadHash<Hash>(hash));
+    }
+
+    template <typename K, typename = detail::EnableTransparent<Hash, Equal, K>>
+    Iterator find(const K& key) {
+        return findHashed(key, hashOf(key));
+    }
+
+    template <typename K, typename = detail::EnableTransparent<Hash, Equal, K>>
+    ConstIterator find(const K& key) const {
+        return findHashed(key, hashOf(key));
+    }
+
+    template <typename K, typename = detail::EnableTransparent<Hash, Equal, K>>
+    Iterator find(const K& key, size_t hash) {
+        return findHashed(key, detail::spreadHash<Hash>(hash));
+    }
+
+    template <typename K, typename = detail::EnableTransparent<Hash, Equal, K>>
+    ConstIterator find(const K& key, size_t hash) const {
+        return findHashed(key, detail::spreadHash<Hash>(hash));
+    }
+
+    Hash hash_function() const {
+        return Hash();
+    }
+
+    // makes room for `count` elements, no rehash happens until there are more
+    void reserve(size_t count) {
+        if (count <= size_ + growthLeft_) return;
+        rehash(std::max(capacity_, capacityFor(count)));
+    }
+
+    constexpr size_t max_size() const {
+        return std::numeric_limits<size_t>::max();
+    }
+
+    double load_factor() const {
+        return capacity_ == 0 ? 0.0 : static_cast<double>(size_) / capacity_;
+    }
+
+    double max_load_factor() const {
+        return maxLoadFactor_;
+    }
+
+    void max_load_factor(double factor) {
+        size_t taken = growthFor(capacity_) - growthLeft_;
+        maxLoadFactor_ = factor;
+        growthLeft_ = growthFor(capacity_) > taken ? growthFor(capacity_) - taken : 0;
+        if (size_ > growthFor(capacity_)) {
+            rehash(capacityFor(size_));
+        }
+    }
+
+    Iterator begin() {
+        Iterator it = firstFull();
+        firstHint_ = it.ctrl_ - ctrl_;
+        return it;
+    }
+
+    ConstIterator begin() const {
+        return cbegin();
+    }
+
+    // does not move firstHint_, so concurrent readers of a const map never write to it
+    ConstIterator cbegin() const {
+        return firstFull();
+    }
+
+    Iterator end() {
+        return iteratorAt(capacity_);
+    }
+
+    ConstIterator end() const {
+        return cend();
+    }
+
+    ConstIterator cend() const {
+        return iteratorAt(capacity_);
+    }
+};
@@ -1,21 +1,26 @@
 #include <vector>
 #include <string>
+#include <string_view>
+#include <memory>
 #include "unordered_map.h"
 #include <unordered_map>
 #include <iterator>
+#include <type_traits>
 #include <cassert>
 #include <iostream>
 
 template <
+        typename Layout,
         typename Key,
         typename Value,
         typename Hash = std::hash<Key>,
         typename Equal = std::equal_to<Key>,
         typename Alloc = std::allocator<std::pair<const Key, Value>>>
-using unordered_map = UnorderedMap<Key, Value, Hash, Equal, Alloc>;
+using unordered_map = UnorderedMap<Key, Value, Hash, Equal, Alloc, Layout>;
 
+template <typename Layout>
 void SimpleTest() {
-    unordered_map<std::string, int> m;
+    unordered_map<Layout, std::string, int> m;
 
     m["aaaaa"] = 5;
     m["bbb"] = 6;
@@ -58,8 +63,9 @@ void SimpleTest() {
     assert(res.second);
 }
 
+template <typename Layout>
 void TestIterators() {
-    unordered_map<double, std::string> m;
+    unordered_map<Layout, double, std::string> m;
 
     std::vector<double> keys = {0.4, 0.3, -8.32, 7.5, 10.0, 0.0};
     std::vector<std::string> values = {
@@ -88,7 +94,7 @@ void TestIterators() {
     assert(beg->second == s);
     assert(m.size() == 4);
  
-    unordered_map<double, std::string> mm;
+    unordered_map<Layout, double, std::string> mm;
     std::vector<std::pair<const double, std::string>> elements = {
         {3.0, values[0]},
         {5.0, values[1]},
@@ -106,8 +112,10 @@ void TestIterators() {
     // Test traverse efficiency
     m.reserve(1'000'000); // once again, nothing really should happen
     assert(m.size() == 8);
-    // Actions below must be quick (~ 1000 * 8 operations) despite reserving space for 1M elements
-    for (int i = 0; i < 10000; ++i) {
+    // Actions below must be quick (~ 1000 * 8 operations) despite reserving space for 1M elements;
+    // a flat table walks its whole capacity, so it gets far fewer rounds
+    int traversals = std::is_same_v<Layout, FlatLayout> ? 10 : 10000;
+    for (int i = 0; i < traversals; ++i) {
         long long h = 0;
         for (auto it = m.cbegin(); it != m.cend(); ++it) {
             // just some senseless action
@@ -139,11 +147,11 @@ void TestIterators() {
 
 // Just a simple SFINAE trick to check CE presence when it's necessary
 // Stay tuned, we'll discuss this kind of tricks in our next lectures ;)
-template<typename T>
-decltype(unordered_map<T, T>().cbegin()->second = 0, int()) TestConstIteratorDoesntAllowModification(T) {
+template<typename Layout, typename T>
+decltype(unordered_map<Layout, T, T>().cbegin()->second = 0, int()) TestConstIteratorDoesntAllowModification(T) {
     assert(false);
 }
-template<typename... FakeArgs>
+template<typename Layout, typename... FakeArgs>
 void TestConstIteratorDoesntAllowModification(FakeArgs...) {}
 
 
@@ -182,8 +190,9 @@ namespace std {
     };
 }
 
+template <typename Layout>
 void TestNoRedundantCopies() {
-    unordered_map<NeitherDefaultNorCopyConstructible, NeitherDefaultNorCopyConstructible> m;
+    unordered_map<Layout, NeitherDefaultNorCopyConstructible, NeitherDefaultNorCopyConstructible> m;
 
     m.reserve(10);
 
@@ -236,8 +245,9 @@ struct OneMoreStrangeStruct {
 bool operator==(const OneMoreStrangeStruct&, const OneMoreStrangeStruct&) = delete;
 
 
+template <typename Layout>
 void TestCustomHashAndCompare() {
-    unordered_map<std::pair<int, int>, char, MyHash<std::pair<int, int>>, 
+    unordered_map<Layout, std::pair<int, int>, char, MyHash<std::pair<int, int>>, 
             MyEqual<std::pair<int, int>>> m;
 
     m.insert({{1, 2}, 0});
@@ -247,7 +257,7 @@ void TestCustomHashAndCompare() {
     m[{3, 6}] = 3;
     assert(m.at({4, 8}) == 3);
 
-    unordered_map<OneMoreStrangeStruct, int, MyHash<OneMoreStrangeStruct>, MyEqual<OneMoreStrangeStruct>> mm;
+    unordered_map<Layout, OneMoreStrangeStruct, int, MyHash<OneMoreStrangeStruct>, MyEqual<OneMoreStrangeStruct>> mm;
     mm[{1, 2}] = 3;
     assert(mm.at({5, 10}) == 3);
 
@@ -371,8 +381,9 @@ struct TheChosenOne<std::pair<const Chaste, Chaste>>
 //    }
 //}
 
+template <typename Layout>
 void TestCustomAlloc2() {
-    unordered_map<int, int> m;
+    unordered_map<Layout, int, int> m;
     m.emplace(0, 0);
     {
         auto mm = m;
@@ -391,12 +402,444 @@ void TestCustomAlloc2() {
     }
 }
 
+// The size stays at 100 while every key is replaced many times over: the erased slots have to be
+// reused or cleaned up in place rather than making the table grow
+template <typename Layout>
+void TestChurn() {
+    unordered_map<Layout, int, int> m;
+    std::unordered_map<int, int> expected;
+    m.reserve(200);
+    for (int i = 0; i < 100; ++i) {
+        m.emplace(i, -i);
+        expected.emplace(i, -i);
+    }
+    double loadFactor = m.load_factor();
+
+    for (int i = 100; i < 100'100; ++i) {
+        m.erase(m.find(i - 100));
+        expected.erase(i - 100);
+        m.emplace(i, -i);
+        expected.emplace(i, -i);
+        if (i % 1000 == 0) {
+            for (const auto& [key, value] : expected) {
+                assert(m.at(key) == value);
+            }
+            assert(m.find(i - 100) == m.end());
+        }
+    }
+    assert(m.size() == 100);
+    assert(m.load_factor() == loadFactor);
+
+    int count = 0;
+    for (const auto& [key, value] : m) {
+        assert(expected.at(key) == value);
+        ++count;
+    }
+    assert(count == 100);
+}
+
+// Erasing from the front must not leave begin() pointing at a freed slot, and a traversal in
+// either direction has to see exactly the remaining elements
+template <typename Layout>
+void TestEraseFromFront() {
+    unordered_map<Layout, int, int> m;
+    for (int i = 0; i < 1000; ++i) {
+        m.emplace(i, i);
+    }
+    const auto& cm = m;
+
+    for (int left = 1000; left > 0; --left) {
+        assert(m.size() == static_cast<size_t>(left));
+        assert(std::distance(m.begin(), m.end()) == left);
+        assert(cm.cbegin() == m.begin());
+        if (left % 100 == 0) {
+            int backward = 0;
+            for (auto it = m.end(); it != m.begin();) {
+                --it;
+                assert(m.find(it->first) == it);
+                ++backward;
+            }
+            assert(backward == left);
+        }
+        m.erase(m.begin());
+    }
+    assert(m.begin() == m.end());
+    assert(cm.cbegin() == cm.cend());
+
+    m.emplace(5, 5);
+    assert(m.begin()->first == 5);
+    assert(std::prev(m.end()) == m.begin());
+}
+
+// Eight keys share every hash value, so they land in one probe run; taking a key out of the
+// middle of a run must not cut off the keys probed after it
+struct EightPerHash {
+    size_t operator()(int key) const {
+        return std::hash<int>()(key / 8);
+    }
+};
+
+template <typename Layout>
+void TestEraseInCollisionRun() {
+    unordered_map<Layout, int, int, EightPerHash> m;
+    for (int i = 0; i < 800; ++i) {
+        m.emplace(i, i);
+    }
+    for (int run = 0; run < 800; run += 8) {
+        m.erase(m.find(run + 3));
+        for (int i = run + 4; i < run + 8; ++i) {
+            assert(m.at(i) == i);
+        }
+        assert(m.find(run + 3) == m.end());
+    }
+    assert(m.size() == 700);
+
+    // the freed places get reused without duplicating the keys that are still there
+    for (int i = 0; i < 800; ++i) {
+        auto res = m.emplace(i, -i);
+        assert(res.second == (i % 8 == 3));
+        assert(m.at(i) == (i % 8 == 3 ? -i : i));
+    }
+    assert(m.size() == 800);
+}
+
+// Only eight hash values for all keys: far more keys share a hash than fit within the usual search
+// distance, which no number of buckets helps with
+struct EightHashes {
+    size_t operator()(int key) const {
+        return std::hash<int>()(key % 8);
+    }
+};
+
+template <typename Layout>
+void TestManyKeysPerHash() {
+    for (int count : {300, 3000}) {
+        unordered_map<Layout, int, int, EightHashes> m;
+        for (int i = 0; i < count; ++i) {
+            assert(m.emplace(i, i).second);
+        }
+        assert(m.size() == static_cast<size_t>(count));
+        // the table did not keep doubling in search of room
+        assert(m.load_factor() >= m.max_load_factor() / 16);
+        for (int i = 0; i < count; ++i) {
+            assert(m.at(i) == i);
+        }
+        assert(m.find(count) == m.end() && m.find(-1) == m.end());
+
+        for (int i = 0; i < count; i += 2) {
+            m.erase(m.find(i));
+        }
+        for (int i = 0; i < count; ++i) {
+            assert((m.find(i) == m.end()) == (i % 2 == 0));
+        }
+        auto copy = m;
+        for (int i = 0; i < count; i += 2) {
+            assert(copy.emplace(i, -i).second);
+        }
+        for (int i = 0; i < count; ++i) {
+            assert(copy.at(i) == (i % 2 == 0 ? -i : i));
+        }
+        assert(m.size() == static_cast<size_t>(count / 2) && copy.size() == static_cast<size_t>(count));
+    }
+}
+
+// Erases issued right after the insert that made the table grow, while the entries may still be
+// spread between the old and the new table
+template <typename Layout>
+void TestEraseAfterGrowth() {
+    unordered_map<Layout, int, int> m;
+    int next = 0;
+    for (int growths = 0; growths < 4; ++growths) {
+        double loadFactor;
+        do {
+            loadFactor = m.load_factor();
+            m.emplace(next, next);
+            ++next;
+        } while (m.load_factor() > loadFactor);
+
+        m.erase(m.find(next - 1));
+        m.erase(m.find(0));
+        m.erase(m.find(next / 2));
+        for (int i = 0; i < next - 1; ++i) {
+            if (i == 0 || i == next / 2) {
+                assert(m.find(i) == m.end());
+            } else {
+                assert(m.at(i) == i);
+            }
+        }
+        m.emplace(0, 0);
+        m.emplace(next / 2, next / 2);
+        m.emplace(next - 1, next - 1);
+        assert(m.size() == static_cast<size_t>(next));
+    }
+}
+
+// Fills a fresh map up to the insert that makes it grow, so a node map is left halfway through
+// moving its entries to the bigger table; returns the number of keys, which are 0 .. count - 1
+template <typename Layout>
+int FillPastGrowth(unordered_map<Layout, int, int>& m) {
+    int count = 0;
+    double loadFactor;
+    do {
+        loadFactor = m.load_factor();
+        m.emplace(count, count);
+        ++count;
+    } while (m.load_factor() > loadFactor);
+    return count;
+}
+
+template <typename Layout>
+void CheckKeys(const unordered_map<Layout, int, int>& m, int count) {
+    assert(m.size() == static_cast<size_t>(count));
+    for (int i = 0; i < count; ++i) {
+        assert(m.at(i) == i);
+    }
+    assert(std::distance(m.begin(), m.end()) == count);
+}
+
+// Every operation has to see the entries still in the old table as well as the moved ones
+template <typename Layout>
+void TestMidGrowth() {
+    {
+        unordered_map<Layout, int, int> m;
+        int count = FillPastGrowth(m);
+        for (int i = 0; i < count; ++i) {
+            assert(m.find(i)->second == i);
+        }
+        assert(m.find(count) == m.end());
+        m.erase(m.find(count / 2));
+        assert(m.find(count / 2) == m.end());
+        assert(m[count - 1] == count - 1);
+        assert(m[count / 2] == 0);
+        m[count / 2] = count / 2;
+        CheckKeys(m, count);
+    }
+    {
+        unordered_map<Layout, int, int> m;
+        int count = FillPastGrowth(m);
+        auto copy = m;
+        CheckKeys(copy, count);
+        copy[count] = count;
+        CheckKeys(m, count);
+        CheckKeys(copy, count + 1);
+
+        unordered_map<Layout, int, int> assigned;
+        assigned.emplace(-1, -1);
+        assigned = m;
+        CheckKeys(assigned, count);
+    }
+    {
+        unordered_map<Layout, int, int> m;
+        int count = FillPastGrowth(m);
+        auto moved = std::move(m);
+        CheckKeys(moved, count);
+        moved[count] = count;
+        CheckKeys(moved, count + 1);
+
+        unordered_map<Layout, int, int> assigned;
+        assigned = std::move(moved);
+        CheckKeys(assigned, count + 1);
+    }
+    {
+        unordered_map<Layout, int, int> m;
+        int count = FillPastGrowth(m);
+        m.reserve(count * 20);
+        CheckKeys(m, count);
+        m[count] = count;
+        CheckKeys(m, count + 1);
+    }
+    {
+        unordered_map<Layout, int, int> m;
+        int count = FillPastGrowth(m);
+        m.max_load_factor(m.max_load_factor() / 4);
+        assert(m.load_factor() <= m.max_load_factor());
+        CheckKeys(m, count);
+        m[count] = count;
+        CheckKeys(m, count + 1);
+    }
+}
+
+struct StringHash {
+    using is_transparent = void;
+
+    size_t operator()(std::string_view s) const {
+        return std::hash<std::string_view>()(s);
+    }
+};
+
+struct StringEqual {
+    using is_transparent = void;
+
+    bool operator()(std::string_view x, std::string_view y) const {
+        return x == y;
+    }
+};
+
+// std::string keys looked up by std::string_view, without building a std::string for the probe
+template <typename Layout>
+void TestHeterogeneousLookup() {
+    unordered_map<Layout, std::string, int, StringHash, StringEqual> m;
+    std::string longKey(100, 'x');
+    m[longKey] = 1;
+    m["short"] = 2;
+    const auto& cm = m;
+
+    std::string_view view = longKey;
+    assert(m.find(view)->second == 1);
+    assert(cm.find(view)->second == 1);
+    assert(m.at(view) == 1);
+    assert(cm.at(std::string_view("short")) == 2);
+    assert(m.find(std::string_view("missing")) == m.end());
+    try {
+        m.at(std::string_view("missing"));
+        assert(false);
+    } catch (const std::out_of_range&) {
+    }
+
+    m[view] = 3;
+    assert(m.at(longKey) == 3);
+    assert(m.size() == 2);
+    m[std::string_view("fresh")] = 4;
+    assert(m.at("fresh") == 4);
+    assert(m.size() == 3);
+
+    // a hash computed once serves any map with the same hasher, with or without a transparent key
+    size_t hash = m.hash_function()(view);
+    assert(m.find(view, hash)->second == 3);
+    assert(cm.find(longKey, hash)->second == 3);
+
+    unordered_map<Layout, int, int> odd;
+    unordered_map<Layout, int, int> all;
+    for (int i = 0; i < 1000; ++i) {
+        all[i] = i;
+        if (i % 2 == 1) {
+            odd[i] = -i;
+        }
+    }
+    for (int i = 0; i < 1000; ++i) {
+        size_t h = all.hash_function()(i);
+        assert(all.find(i, h)->second == i);
+        assert((odd.find(i, h) != odd.end()) == (i % 2 == 1));
+    }
+}
+
+// Counts how many times a value is default-constructed and how many times it is moved
+struct Counted {
+    static int defaults;
+    static int moves;
+
+    std::string s;
+
+    Counted() {
+        ++defaults;
+    }
+    explicit Counted(std::string s): s(std::move(s)) {}
+    Counted(const Counted&) = default;
+    Counted(Counted&& other): s(std::move(other.s)) {
+        ++moves;
+    }
+    Counted& operator=(const Counted&) = default;
+    Counted& operator=(Counted&& other) {
+        s = std::move(other.s);
+        ++moves;
+        return *this;
+    }
+};
+
+int Counted::defaults = 0;
+int Counted::moves = 0;
+
+template <typename Layout>
+void TestTryEmplace() {
+    unordered_map<Layout, int, Counted> m;
+    m.reserve(100);
+
+    // operator[] constructs the value once, in place, and only when the key is new
+    Counted::defaults = Counted::moves = 0;
+    m[1].s = "one";
+    assert(Counted::defaults == 1 && Counted::moves == 0);
+    m[1].s += "!";
+    assert(Counted::defaults == 1 && Counted::moves == 0);
+    assert(m.at(1).s == "one!");
+
+    // on a hit the arguments are left alone
+    std::string arg = "two";
+    auto res = m.try_emplace(1, std::move(arg));
+    assert(!res.second && res.first->second.s == "one!");
+    assert(arg == "two");
+    res = m.try_emplace(2, std::move(arg));
+    assert(res.second && m.at(2).s == "two");
+
+    int key = 3;
+    Counted value("three");
+    Counted::moves = 0;
+    res = m.try_emplace(std::move(key), std::move(value));
+    assert(res.second && Counted::moves == 1);
+    assert(value.s.empty());
+
+    value.s = "assigned";
+    res = m.insert_or_assign(3, std::move(value));
+    assert(!res.second && m.at(3).s == "assigned");
+    res = m.insert_or_assign(4, Counted("four"));
+    assert(res.second && m.at(4).s == "four");
+    assert(m.size() == 4);
+    assert(Counted::defaults == 1);
+}
+
+template <typename Layout>
+void TestMoveOnlyValue() {
+    unordered_map<Layout, std::string, std::unique_ptr<int>> m;
+    std::string key = "key";
+    auto ptr = std::make_unique<int>(1);
+    assert(m.try_emplace(std::move(key), std::move(ptr)).second);
+    assert(key.empty() && !ptr);
+    assert(*m.at("key") == 1);
+
+    // a hit takes neither the key nor the pointer
+    key = "key";
+    ptr = std::make_unique<int>(2);
+    assert(!m.try_emplace(std::move(key), std::move(ptr)).second);
+    assert(key == "key" && *ptr == 2);
+
+    m.insert_or_assign("key", std::move(ptr));
+    assert(*m.at("key") == 2);
+    assert(!m["empty"]);
+    m["empty"] = std::make_unique<int>(3);
+
+    for (int i = 0; i < 1000; ++i) {
+        m.emplace(std::to_string(i), std::make_unique<int>(i));
+    }
+    auto moved = std::move(m);
+    assert(moved.size() == 1002);
+    for (int i = 0; i < 1000; ++i) {
+        assert(*moved.at(std::to_string(i)) == i);
+    }
+    assert(*moved.at("key") == 2 && *moved.at("empty") == 3);
+    moved.erase(moved.find("key"));
+    assert(moved.size() == 1001);
+}
+
+
+template <typename Layout>
+void RunTests() {
+    SimpleTest<Layout>();
+    TestIterators<Layout>();
+    TestConstIteratorDoesntAllowModification<Layout>(0);
+    TestNoRedundantCopies<Layout>();
+    TestCustomHashAndCompare<Layout>();
+    TestCustomAlloc2<Layout>();
+    TestChurn<Layout>();
+    TestEraseFromFront<Layout>();
+    TestEraseInCollisionRun<Layout>();
+    TestManyKeysPerHash<Layout>();
+    TestEraseAfterGrowth<Layout>();
+    TestMidGrowth<Layout>();
+    TestHeterogeneousLookup<Layout>();
+    TestTryEmplace<Layout>();
+    TestMoveOnlyValue<Layout>();
+}
 
 int main() {
-    SimpleTest();
-    TestIterators();
-    TestConstIteratorDoesntAllowModification(0);
-    TestNoRedundantCopies();
-    TestCustomHashAndCompare();
-    TestCustomAlloc2();
+    RunTests<NodeLayout>();
+    RunTests<FlatLayout>();
 }
@@ -0,0 +1,26 @@
+#pragma once
+#include <chrono>
+#include <cstdio>
+#include <cstddef>
+
+// What the container benchmarks share: an element of a given size, a timer and the output line.
+
+template <size_t Size>
+struct Object {
+    long long data[Size / sizeof(long long)] = {};
+};
+
+class Timer {
+    std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+
+public:
+    double nsPer(size_t ops) const {
+        auto elapsed = std::chrono::steady_clock::now() - start_;
+        return std::chrono::duration<double, std::nano>(elapsed).count() / ops;
+    }
+};
+
+// one tab-separated line: operation, element size, container, ns
+inline void Report(const char* operation, size_t size, const char* container, double ns) {
+    std::printf("%s\t%zu\t%s\t%.2f\n", operation, size, container, ns);
+}
@@ -0,0 +1,247 @@
+#pragma once
+
+#include <new>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+// Unbounded lock-free MPMC queue (Michael-Scott) for use as a work queue shared by many threads.
+// Nodes come from Alloc the same way List nodes do, so the allocator has to be thread-safe;
+// FastAllocator is, and it lets a node be freed by another thread than the one that allocated it.
+//
+// Popped nodes are reclaimed with hazard pointers: every operation borrows a record holding two
+// hazard slots, a node is freed only when no record points at it. Records are never freed before
+// the queue, their number is bounded by the number of operations running at the same time.
+template <typename T, typename Alloc = std::allocator<T>>
+class ConcurrentQueue {
+    // the head node is a dummy whose value was moved out (or never built), the others hold values
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* value() {
+            return std::launder(reinterpret_cast<T*>(storage));
+        }
+    };
+
+    struct HazardRecord {
+        std::atomic<Node*> hazard[2] = {};
+        std::atomic<bool> active{true};
+        HazardRecord* next = nullptr;
+        // owned by whoever holds the record, kept when it is given back
+        std::vector<Node*> retired;
+    };
+
+    // borrows a record for the duration of one operation
+    class HazardGuard {
+    private:
+        ConcurrentQueue& queue_;
+        HazardRecord* record_;
+
+    public:
+        explicit HazardGuard(ConcurrentQueue& queue): queue_(queue), record_(queue.acquire()) {}
+
+        HazardGuard(const HazardGuard&) = delete;
+        HazardGuard& operator=(const HazardGuard&) = delete;
+
+        ~HazardGuard() {
+            record_->hazard[0].store(nullptr);
+            record_->hazard[1].store(nullptr);
+            record_->active.store(false, std::memory_order_release);
+        }
+
+        // reads src until the pointer published in the slot is still the one in src
+        Node* protect(size_t slot, const std::atomic<Node*>& src) {
+            Node* ptr = src.load();
+            while (true) {
+                record_->hazard[slot].store(ptr);
+                Node* again = src.load();
+                if (again == ptr) return ptr;
+                ptr = again;
+            }
+        }
+
+        void retire(Node* node) {
+            record_->retired.push_back(node);
+            if (record_->retired.size() >= 2 * kSlots * queue_.recordCount_.load() + 64) {
+                queue_.scan(record_->retired);
+            }
+        }
+    };
+
+    using Traits = std::allocator_traits<Alloc>;
+    using TraitsNode = typename std::allocator_traits<Alloc>::template rebind_traits<Node>;
+
+    static constexpr size_t kSlots = 2;
+    static constexpr size_t kCacheLine = 64;
+
+    Alloc alloc_;
+    typename std::allocator_traits<Alloc>::template rebind_alloc<Node> allocNode_;
+    // producers and consumers work on different ends, keep them on different cache lines
+    alignas(kCacheLine) std::atomic<Node*> head_;
+    alignas(kCacheLine) std::atomic<Node*> tail_;
+    alignas(kCacheLine) std::atomic<HazardRecord*> records_{nullptr};
+    std::atomic<size_t> recordCount_{0};
+
+    Node* newNode() {
+        Node* node = TraitsNode::allocate(allocNode_, 1);
+        ::new (static_cast<void*>(node)) Node();
+        return node;
+    }
+
+    void freeNode(Node* node) {
+        node->~Node();
+        TraitsNode::deallocate(allocNode_, node, 1);
+    }
+
+    HazardRecord* acquire() {
+        for (HazardRecord* it = records_.load(std::memory_order_acquire); it != nullptr; it = it->next) {
+            bool expected = false;
+            if (!it->active.load(std::memory_order_relaxed) &&
+                it->active.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                return it;
+            }
+        }
+        HazardRecord* record = new HazardRecord();
+        record->next = records_.load(std::memory_order_relaxed);
+        while (!records_.compare_exchange_weak(record->next, record, std::memory_order_release,
+                                               std::memory_order_relaxed)) {}
+        recordCount_.fetch_add(1);
+        return record;
+    }
+
+    // frees the retired nodes that no record points at
+    void scan(std::vector<Node*>& retired) {
+        std::vector<Node*> hazards;
+        for (HazardRecord* it = records_.load(std::memory_order_acquire); it != nullptr; it = it->next) {
+            for (auto& hazard : it->hazard) {
+                if (Node* node = hazard.load()) hazards.push_back(node);
+            }
+        }
+        std::sort(hazards.begin(), hazards.end());
+        auto kept = std::partition(retired.begin(), retired.end(), [&hazards](Node* node) {
+            return std::binary_search(hazards.begin(), hazards.end(), node);
+        });
+        for (auto it = kept; it != retired.end(); ++it) {
+            freeNode(*it);
+        }
+        retired.erase(kept, retired.end());
+    }
+
+    void link(Node* node) {
+        HazardGuard guard(*this);
+        while (true) {
+            Node* tail = guard.protect(0, tail_);
+            Node* next = tail->next.load();
+            if (tail != tail_.load()) continue;
+            if (next != nullptr) {
+                // another push linked its node but has not moved tail_ yet, help it
+                tail_.compare_exchange_weak(tail, next);
+                continue;
+            }
+            if (tail->next.compare_exchange_weak(next, node)) {
+                tail_.compare_exchange_strong(tail, node);
+                return;
+            }
+        }
+    }
+
+public:
+    explicit ConcurrentQueue(const Alloc& alloc = Alloc()): alloc_(alloc), allocNode_(alloc) {
+        Node* dummy = newNode();
+        head_.store(dummy);
+        tail_.store(dummy);
+    }
+
+    ConcurrentQueue(const ConcurrentQueue&) = delete;
+    ConcurrentQueue& operator=(const ConcurrentQueue&) = delete;
+
+    // no other thread may use the queue any more
+    ~ConcurrentQueue() {
+        Node* node = head_.load();
+        Node* next = node->next.load();
+        freeNode(node);
+        for (node = next; node != nullptr; node = next) {
+            next = node->next.load();
+            Traits::destroy(alloc_, node->value());
+            freeNode(node);
+        }
+        HazardRecord* record = records_.load();
+        while (record != nullptr) {
+            HazardRecord* next = record->next;
+            for (Node* retired : record->retired) {
+                freeNode(retired);
+            }
+            delete record;
+            record = next;
+        }
+    }
+
+    template <typename... Args>
+    void emplace(Args&&... args) {
+        Node* node = newNode();
+        try {
+            Traits::construct(alloc_, node->value(), std::forward<Args>(args)...);
+        } catch (...) {
+            freeNode(node);
+            throw;
+        }
+        link(node);
+    }
+
+    void push(const T& value) {
+        emplace(value);
+    }
+
+    void push(T&& value) {
+        emplace(std::move(value));
+    }
+
+    // the queue is unbounded, so this always succeeds; it is here to match bounded queues
+    bool try_push(const T& value) {
+        push(value);
+        return true;
+    }
+
+    bool try_push(T&& value) {
+        push(std::move(value));
+        return true;
+    }
+
+    // moves the front element into `out`, returns false if the queue was empty
+    bool try_pop(T& out) {
+        HazardGuard guard(*this);
+        while (true) {
+            Node* head = guard.protect(0, head_);
+            Node* tail = tail_.load();
+            Node* next = guard.protect(1, head->next);
+            if (head != head_.load()) continue;
+            if (next == nullptr) return false;
+            if (head == tail) {
+                tail_.compare_exchange_weak(tail, next);
+                continue;
+            }
+            if (head_.compare_exchange_weak(head, next)) {
+                // next is the new dummy: only this thread touches its value, the hazard keeps it alive
+                guard.retire(head);
+                try {
+                    out = std::move(*next->value());
+                } catch (...) {
+                    Traits::destroy(alloc_, next->value());
+                    throw;
+                }
+                Traits::destroy(alloc_, next->value());
+                return true;
+            }
+        }
+    }
+
+    // may be outdated by the time it returns if other threads are pushing or popping
+    bool empty() {
+        HazardGuard guard(*this);
+        Node* head = guard.protect(0, head_);
+        return head->next.load() == nullptr;
+    }
+};
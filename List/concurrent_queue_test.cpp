@@ -0,0 +1,110 @@
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cassert>
+#include "fast_allocator.h"
+#include "concurrent_queue.h"
+
+template <typename Alloc>
+void SimpleTest() {
+    ConcurrentQueue<std::string, Alloc> q;
+    std::string s;
+    assert(q.empty());
+    assert(!q.try_pop(s));
+
+    q.push("first");
+    q.emplace(3, 'x');
+    std::string third = "third";
+    assert(q.try_push(third));
+    assert(!q.empty());
+
+    assert(q.try_pop(s) && s == "first");
+    assert(q.try_pop(s) && s == "xxx");
+    assert(q.try_pop(s) && s == "third");
+    assert(!q.try_pop(s));
+    assert(q.empty());
+
+    // whatever is left is destroyed with the queue
+    q.push("left");
+    q.push("over");
+}
+
+// every value 0 .. producers * perProducer - 1 is pushed once, the consumers add up what they pop
+template <typename Alloc>
+void StressTest(int producers, int consumers, long long perProducer) {
+    ConcurrentQueue<long long, Alloc> q;
+    long long total = producers * perProducer;
+    std::atomic<long long> sum{0};
+    std::atomic<long long> popped{0};
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&q, p, perProducer] {
+            for (long long i = 0; i < perProducer; ++i) {
+                q.push(p * perProducer + i);
+            }
+        });
+    }
+    for (int c = 0; c < consumers; ++c) {
+        threads.emplace_back([&] {
+            long long value;
+            long long localSum = 0;
+            while (popped.load() < total) {
+                if (q.try_pop(value)) {
+                    localSum += value;
+                    popped.fetch_add(1);
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+            sum.fetch_add(localSum);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    assert(popped.load() == total);
+    assert(sum.load() == total * (total - 1) / 2);
+    assert(q.empty());
+}
+
+// nodes pushed by one thread are popped and freed by another, so FastAllocator gets chunks back
+// on threads that never allocated them
+void CrossThreadFreeTest() {
+    ConcurrentQueue<std::string, FastAllocator<std::string>> q;
+    const int kCount = 20'000;
+    std::thread producer([&q] {
+        for (int i = 0; i < kCount; ++i) {
+            q.push(std::to_string(i));
+        }
+    });
+    long long sum = 0;
+    int popped = 0;
+    std::string s;
+    while (popped < kCount) {
+        if (q.try_pop(s)) {
+            sum += std::stoll(s);
+            ++popped;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    assert(sum == static_cast<long long>(kCount) * (kCount - 1) / 2);
+    assert(q.empty());
+}
+
+int main() {
+    SimpleTest<std::allocator<std::string>>();
+    SimpleTest<FastAllocator<std::string>>();
+
+    StressTest<std::allocator<long long>>(1, 1, 50'000);
+    StressTest<std::allocator<long long>>(4, 4, 20'000);
+    StressTest<FastAllocator<long long>>(1, 1, 50'000);
+    StressTest<FastAllocator<long long>>(4, 4, 20'000);
+    StressTest<FastAllocator<long long>>(8, 2, 10'000);
+
+    CrossThreadFreeTest();
+}
@@ -1,33 +1,727 @@
 #pragma once
 
 #include <new>
+#include <mutex>
+#include <atomic>
+#include <limits>
 #include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
 #include <cassert>
 #include <iostream>
 #include <functional>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#endif
+
+// requests up to this many bytes are served by size classes, larger ones by whole pages
+#ifndef FAST_ALLOCATOR_MAX_CHUNK
+#define FAST_ALLOCATOR_MAX_CHUNK 4096
+#endif
+
+// Statistics are compiled in with -DFAST_ALLOCATOR_STATS, otherwise every hook below is an empty inline function.
+#ifdef FAST_ALLOCATOR_STATS
+
+class AllocationTag;
+
+namespace detail {
+class StatsRegistry;
+
+// counters of one FixedAllocator<chunkSize>
+class SizeClassStats {
+private:
+    size_t chunkSize_;
+    std::atomic<size_t> allocations_{0};
+    std::atomic<size_t> deallocations_{0};
+    std::atomic<size_t> peakLive_{0};
+    std::atomic<size_t> carved_{0};
+    std::atomic<size_t> releasedChunks_{0};
+    std::atomic<size_t> reserved_{0};
+    std::atomic<size_t> released_{0};
+    SizeClassStats* next_ = nullptr;
+
+    friend class StatsRegistry;
+
+public:
+    explicit SizeClassStats(size_t chunkSize);
+    ~SizeClassStats();
+
+    void onAllocate() {
+        size_t live = allocations_.fetch_add(1, std::memory_order_relaxed) + 1
+                      - deallocations_.load(std::memory_order_relaxed);
+        size_t peak = peakLive_.load(std::memory_order_relaxed);
+        while (live > peak && !peakLive_.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+    }
+
+    void onDeallocate() {
+        deallocations_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void onCarve(size_t chunks) {
+        carved_.fetch_add(chunks, std::memory_order_relaxed);
+    }
+
+    void onMap(size_t bytes) {
+        reserved_.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    void onUnmap(size_t bytes, size_t chunks) {
+        reserved_.fetch_sub(bytes, std::memory_order_relaxed);
+        released_.fetch_add(bytes, std::memory_order_relaxed);
+        releasedChunks_.fetch_add(chunks, std::memory_order_relaxed);
+    }
+};
+
+// process-wide list of size classes, allocation size histogram and tags
+class StatsRegistry {
+private:
+    static constexpr size_t kBuckets = 64;
+
+    std::mutex mutex_;
+    SizeClassStats* classes_ = nullptr;
+    AllocationTag* tags_ = nullptr;
+    std::atomic<size_t> histogram_[kBuckets] = {};
+
+    StatsRegistry() = default;
+
+    template <typename Node>
+    static void link(Node*& head, Node* node) {
+        node->next_ = head;
+        head = node;
+    }
+
+    template <typename Node>
+    static void unlink(Node*& head, Node* node) {
+        for (Node** it = &head; *it != nullptr; it = &(*it)->next_) {
+            if (*it == node) {
+                *it = node->next_;
+                return;
+            }
+        }
+    }
+
+    static size_t bucket(size_t bytes) {
+        size_t ans = 0;
+        while (ans + 1 < kBuckets && (size_t(1) << ans) < bytes) ++ans;
+        return ans;
+    }
+
+    friend class ::AllocationTag;
+    friend class SizeClassStats;
+
+public:
+    static StatsRegistry& instance() {
+        static StatsRegistry singleton;
+        return singleton;
+    }
+
+    void onRequest(size_t bytes);
+    void onRelease(size_t bytes);
+
+    void dump(std::ostream& out);
+    void dumpJson(std::ostream& out);
+};
+
+inline SizeClassStats::SizeClassStats(size_t chunkSize): chunkSize_(chunkSize) {
+    StatsRegistry& registry = StatsRegistry::instance();
+    std::lock_guard<std::mutex> lock(registry.mutex_);
+    StatsRegistry::link(registry.classes_, this);
+}
+
+inline SizeClassStats::~SizeClassStats() {
+    StatsRegistry& registry = StatsRegistry::instance();
+    std::lock_guard<std::mutex> lock(registry.mutex_);
+    StatsRegistry::unlink(registry.classes_, this);
+}
+}
+
+// Attributes allocations to a named consumer, e.g. one tag per container kind:
+//     static AllocationTag lruTag("lru");
+//     AllocationTag::Scope scope(lruTag);
+// Operations are counted against the tag active on the calling thread when they happen.
+class AllocationTag {
+private:
+    const char* name_;
+    std::atomic<size_t> allocations_{0};
+    std::atomic<size_t> deallocations_{0};
+    std::atomic<size_t> bytesAllocated_{0};
+    std::atomic<size_t> bytesDeallocated_{0};
+    AllocationTag* next_ = nullptr;
+
+    inline static thread_local AllocationTag* current_ = nullptr;
+
+    friend class detail::StatsRegistry;
+
+public:
+    explicit AllocationTag(const char* name): name_(name) {
+        detail::StatsRegistry& registry = detail::StatsRegistry::instance();
+        std::lock_guard<std::mutex> lock(registry.mutex_);
+        detail::StatsRegistry::link(registry.tags_, this);
+    }
+
+    AllocationTag(const AllocationTag&) = delete;
+    AllocationTag& operator=(const AllocationTag&) = delete;
+
+    ~AllocationTag() {
+        detail::StatsRegistry& registry = detail::StatsRegistry::instance();
+        std::lock_guard<std::mutex> lock(registry.mutex_);
+        detail::StatsRegistry::unlink(registry.tags_, this);
+    }
+
+    class Scope {
+    private:
+        AllocationTag* previous_;
+
+    public:
+        explicit Scope(AllocationTag& tag): previous_(current_) {
+            current_ = &tag;
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        ~Scope() {
+            current_ = previous_;
+        }
+    };
+};
+
+namespace detail {
+inline void StatsRegistry::onRequest(size_t bytes) {
+    histogram_[bucket(bytes)].fetch_add(1, std::memory_order_relaxed);
+    if (AllocationTag* tag = AllocationTag::current_) {
+        tag->allocations_.fetch_add(1, std::memory_order_relaxed);
+        tag->bytesAllocated_.fetch_add(bytes, std::memory_order_relaxed);
+    }
+}
+
+inline void StatsRegistry::onRelease(size_t bytes) {
+    if (AllocationTag* tag = AllocationTag::current_) {
+        tag->deallocations_.fetch_add(1, std::memory_order_relaxed);
+        tag->bytesDeallocated_.fetch_add(bytes, std::memory_order_relaxed);
+    }
+}
+
+inline void StatsRegistry::dump(std::ostream& out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    out << "chunk\tallocs\tfrees\tlive\tpeak\tfree\treserved\treleased\n";
+    for (SizeClassStats* it = classes_; it != nullptr; it = it->next_) {
+        size_t allocations = it->allocations_.load();
+        size_t deallocations = it->deallocations_.load();
+        size_t live = allocations - deallocations;
+        size_t free = it->carved_.load() - it->releasedChunks_.load() - live;
+        out << it->chunkSize_ << '\t' << allocations << '\t' << deallocations << '\t' << live << '\t'
+            << it->peakLive_.load() << '\t' << free << '\t' << it->reserved_.load() << '\t'
+            << it->released_.load() << '\n';
+    }
+    out << "size<=\tcount\n";
+    for (size_t i = 0; i < kBuckets; ++i) {
+        if (size_t count = histogram_[i].load()) {
+            out << (size_t(1) << i) << '\t' << count << '\n';
+        }
+    }
+    out << "tag\tallocs\tfrees\tbytes allocated\tbytes freed\n";
+    for (AllocationTag* it = tags_; it != nullptr; it = it->next_) {
+        out << it->name_ << '\t' << it->allocations_.load() << '\t' << it->deallocations_.load() << '\t'
+            << it->bytesAllocated_.load() << '\t' << it->bytesDeallocated_.load() << '\n';
+    }
+}
+
+inline void StatsRegistry::dumpJson(std::ostream& out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    out << "{\"enabled\":true,\"sizeClasses\":[";
+    for (SizeClassStats* it = classes_; it != nullptr; it = it->next_) {
+        size_t allocations = it->allocations_.load();
+        size_t deallocations = it->deallocations_.load();
+        size_t live = allocations - deallocations;
+        size_t free = it->carved_.load() - it->releasedChunks_.load() - live;
+        out << (it == classes_ ? "" : ",") << "{\"chunkSize\":" << it->chunkSize_
+            << ",\"allocations\":" << allocations << ",\"deallocations\":" << deallocations
+            << ",\"live\":" << live << ",\"peakLive\":" << it->peakLive_.load() << ",\"free\":" << free
+            << ",\"reservedBytes\":" << it->reserved_.load() << ",\"releasedBytes\":" << it->released_.load()
+            << "}";
+    }
+    out << "],\"histogram\":[";
+    bool first = true;
+    for (size_t i = 0; i < kBuckets; ++i) {
+        if (size_t count = histogram_[i].load()) {
+            out << (first ? "" : ",") << "{\"upTo\":" << (size_t(1) << i) << ",\"count\":" << count << "}";
+            first = false;
+        }
+    }
+    out << "],\"tags\":[";
+    for (AllocationTag* it = tags_; it != nullptr; it = it->next_) {
+        out << (it == tags_ ? "" : ",") << "{\"name\":\"" << it->name_ << "\",\"allocations\":"
+            << it->allocations_.load() << ",\"deallocations\":" << it->deallocations_.load()
+            << ",\"bytesAllocated\":" << it->bytesAllocated_.load()
+            << ",\"bytesDeallocated\":" << it->bytesDeallocated_.load() << "}";
+    }
+    out << "]}\n";
+}
+}
+
+#else
+
 namespace detail {
-// this is singleton
+struct SizeClassStats {
+    explicit SizeClassStats(size_t) {}
+    void onAllocate() {}
+    void onDeallocate() {}
+    void onCarve(size_t) {}
+    void onMap(size_t) {}
+    void onUnmap(size_t, size_t) {}
+};
+
+struct StatsRegistry {
+    static StatsRegistry& instance() {
+        static StatsRegistry singleton;
+        return singleton;
+    }
+
+    void onRequest(size_t) {}
+    void onRelease(size_t) {}
+
+    void dump(std::ostream& out) {
+        out << "allocator statistics are disabled, build with -DFAST_ALLOCATOR_STATS\n";
+    }
+
+    void dumpJson(std::ostream& out) {
+        out << "{\"enabled\":false}\n";
+    }
+};
+}
+
+class AllocationTag {
+public:
+    explicit AllocationTag(const char*) {}
+
+    struct Scope {
+        explicit Scope(AllocationTag&) {}
+    };
+};
+
+#endif
+
+namespace detail {
+static_assert(sizeof(uintptr_t) <= 8, "LockFreeStack packs a pointer and an ABA tag into 64 bits");
+
+// Treiber stack of nodes with `std::atomic<Node*> next`.
+// The head is a pointer and an ABA counter in one 64-bit word: user-space pointers fit into 48 bits on x86-64
+// and AArch64, so the upper 16 bits are the counter; 32-bit targets keep the whole upper half for it and
+// compare-and-swap the pair as a double-width word (cmpxchg8b, ldrexd/strexd).
+// Nodes are never freed while the stack is in use, so a stale `next` read in pop() is harmless.
+template <typename Node>
+class LockFreeStack {
+private:
+    static constexpr uint64_t kTagShift = sizeof(uintptr_t) == 8 ? 48 : 32;
+    static constexpr uint64_t kPtrMask = (uint64_t(1) << kTagShift) - 1;
+    static constexpr uint64_t kTagStep = uint64_t(1) << kTagShift;
+
+    std::atomic<uint64_t> head_{0};
+
+    static Node* ptr(uint64_t head) {
+        return reinterpret_cast<Node*>(static_cast<uintptr_t>(head & kPtrMask));
+    }
+
+    static uint64_t pack(Node* node, uint64_t oldHead) {
+        return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(node)) | ((oldHead & ~kPtrMask) + kTagStep);
+    }
+
+public:
+    void push(Node* node) {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        do {
+            node->next.store(ptr(head), std::memory_order_relaxed);
+        } while (!head_.compare_exchange_weak(head, pack(node, head),
+                                              std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    Node* pop() {
+        uint64_t head = head_.load(std::memory_order_acquire);
+        while (Node* node = ptr(head)) {
+            Node* next = node->next.load(std::memory_order_relaxed);
+            if (head_.compare_exchange_weak(head, pack(next, head),
+                                            std::memory_order_acquire, std::memory_order_acquire)) {
+                return node;
+            }
+        }
+        return nullptr;
+    }
+};
+
+// memory for blocks is mapped directly so that trim() really gives it back
+inline void* mapPages(size_t size) {
+#if defined(__unix__) || defined(__APPLE__)
+    void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) throw std::bad_alloc();
+    return ptr;
+#else
+    return ::operator new(size);
+#endif
+}
+
+inline void unmapPages(void* ptr, size_t size) {
+#if defined(__unix__) || defined(__APPLE__)
+    munmap(ptr, size);
+#else
+    (void)size;
+    ::operator delete(ptr);
+#endif
+}
+
+constexpr size_t kPageSize = 4096;
+
+// 8-byte steps up to 64 bytes, then four geometrically spaced classes per power of two
+// up to FAST_ALLOCATOR_MAX_CHUNK; larger requests go to PageAllocator
+constexpr size_t kMaxChunkSize = FAST_ALLOCATOR_MAX_CHUNK;
+
+constexpr size_t nextChunkSize(size_t chunkSize) {
+    if (chunkSize < 64) return chunkSize + 8;
+    size_t step = 16;
+    while (step * 8 <= chunkSize) step *= 2;
+    return chunkSize + step;
+}
+
+// chunks of a class are aligned to the lowest set bit of their size
+constexpr size_t chunkAlignment(size_t chunkSize) {
+    return std::min(chunkSize & (~chunkSize + 1), kPageSize);
+}
+
+template <typename T>
+constexpr bool fitsChunk(size_t n, size_t chunkSize) {
+    return n * sizeof(T) <= chunkSize && alignof(T) <= chunkAlignment(chunkSize);
+}
+
+// Spans of whole pages. Spans up to kMaxCachedPages are kept for reuse, larger ones are mapped on demand.
+// Requests here are big enough for a mutex not to matter.
+class PageAllocator {
+private:
+    static constexpr size_t kMaxCachedPages = 64;
+    static constexpr size_t kMaxCachedSpans = 16;
+
+    struct Span {
+        Span* next;
+    };
+
+    std::mutex mutex_;
+    Span* spans_[kMaxCachedPages + 1] = {};
+    size_t count_[kMaxCachedPages + 1] = {};
+
+    static size_t pages(size_t bytes) {
+        return (bytes + kPageSize - 1) / kPageSize;
+    }
+
+    PageAllocator() = default;
+
+    ~PageAllocator() {
+        trim();
+    }
+
+public:
+    static PageAllocator& instance() {
+        static PageAllocator singleton;
+        return singleton;
+    }
+
+    void* allocate(size_t bytes) {
+        size_t n = pages(bytes);
+        if (n <= kMaxCachedPages) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (Span* span = spans_[n]) {
+                spans_[n] = span->next;
+                --count_[n];
+                return span;
+            }
+        }
+        return mapPages(n * kPageSize);
+    }
+
+    void deallocate(void* ptr, size_t bytes) {
+        size_t n = pages(bytes);
+        if (n <= kMaxCachedPages) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (count_[n] < kMaxCachedSpans) {
+                spans_[n] = new (ptr) Span{spans_[n]};
+                ++count_[n];
+                return;
+            }
+        }
+        unmapPages(ptr, n * kPageSize);
+    }
+
+    size_t trim() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t released = 0;
+        for (size_t n = 1; n <= kMaxCachedPages; ++n) {
+            while (Span* span = spans_[n]) {
+                spans_[n] = span->next;
+                unmapPages(span, n * kPageSize);
+                released += n * kPageSize;
+            }
+            count_[n] = 0;
+        }
+        return released;
+    }
+};
+
+// a free chunk stores the link to the next one in itself
+struct FreeChunk {
+    FreeChunk* next;
+};
+
+// bounded intrusive stack of free chunks, owned by one thread or parked in the depot
+struct Magazine {
+    static constexpr size_t kCapacity = 32;
+
+    std::atomic<Magazine*> next{nullptr};
+    FreeChunk* head = nullptr;
+    size_t count = 0;
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    bool full() const {
+        return count == kCapacity;
+    }
+
+    void push(void* ptr) {
+        head = new (ptr) FreeChunk{head};
+        ++count;
+    }
+
+    void* pop() {
+        FreeChunk* chunk = head;
+        head = chunk->next;
+        --count;
+        return chunk;
+    }
+};
+
+// this is singleton: a shared lock-free depot of magazines per chunk size,
+// every thread talks to it through its own ThreadCache
 template <size_t chunkSize>
 class FixedAllocator {
 private:
-    std::vector<void*> data_;
-    std::vector<void*> unused_;
-    size_t lastIdx_ = 0;
+    struct Block {
+        Block* next = nullptr;
+        size_t size = 0;
+        size_t capacity = 0;
+        size_t carved = 0;
+        std::atomic<bool> sealed{false};
+
+        char* data() {
+            return reinterpret_cast<char*>(this) + kHeaderSize;
+        }
+    };
+
+    // the data of a block starts aligned to chunkAlignment(chunkSize), and so does every chunk
+    static constexpr size_t kDataAlignment = std::max(alignof(std::max_align_t), chunkAlignment(chunkSize));
+    static constexpr size_t kHeaderSize = (sizeof(Block) + kDataAlignment - 1) / kDataAlignment * kDataAlignment;
+    static constexpr size_t kMaxBlockSize = 256 * 1024;
+    static constexpr size_t kMaxBlockShift = 16;
+
+    // Bonwick-style cache: `loaded_` serves requests, `previous_` absorbs bursts,
+    // the depot is touched once per Magazine::kCapacity operations at most
+    class ThreadCache {
+    private:
+        FixedAllocator<chunkSize>& depot_;
+        Magazine* loaded_;
+        Magazine* previous_;
+        Block* block_ = nullptr;
+        char* cursor_ = nullptr;
+        char* blockEnd_ = nullptr;
+        size_t blockCount_ = 0;
+
+        void reload() {
+            if (!previous_->empty()) {
+                std::swap(loaded_, previous_);
+                return;
+            }
+            if (Magazine* full = depot_.popFull()) {
+                depot_.empty_.push(previous_);
+                previous_ = loaded_;
+                loaded_ = full;
+                return;
+            }
+            carve();
+        }
+
+        void unload() {
+            if (!previous_->full()) {
+                std::swap(loaded_, previous_);
+                return;
+            }
+            depot_.pushFull(previous_);
+            previous_ = loaded_;
+            loaded_ = depot_.emptyMagazine();
+        }
+
+        void carve() {
+            depot_.stats_.onCarve(Magazine::kCapacity - loaded_->count);
+            while (!loaded_->full()) {
+                if (cursor_ == blockEnd_) {
+                    seal();
+                    // blocks double in size up to kMaxBlockSize
+                    size_t chunks = Magazine::kCapacity << std::min(blockCount_++, kMaxBlockShift);
+                    block_ = depot_.newBlock(std::max(Magazine::kCapacity, std::min(chunks, kMaxBlockSize / chunkSize)));
+                    cursor_ = block_->data();
+                    blockEnd_ = cursor_ + block_->capacity * chunkSize;
+                }
+                loaded_->push(cursor_);
+                cursor_ += chunkSize;
+                ++block_->carved;
+            }
+        }
+
+        // nothing more is carved from the current block, trim() may release it from now on
+        void seal() {
+            if (block_ != nullptr) {
+                block_->sealed.store(true, std::memory_order_release);
+            }
+        }
+
+    public:
+        explicit ThreadCache(FixedAllocator<chunkSize>& depot):
+                depot_(depot), loaded_(depot.emptyMagazine()), previous_(depot.emptyMagazine()) {}
+
+        ThreadCache(const ThreadCache&) = delete;
+        ThreadCache& operator=(const ThreadCache&) = delete;
+
+        ~ThreadCache() {
+            seal();
+            depot_.release(loaded_);
+            depot_.release(previous_);
+            destroyed = true;
+        }
+
+        inline static thread_local bool destroyed = false;
+
+        void* allocate() {
+            if (loaded_->empty()) reload();
+            return loaded_->pop();
+        }
+
+        void deallocate(void* ptr) {
+            if (loaded_->full()) unload();
+            loaded_->push(ptr);
+        }
+
+        template <typename Ptr>
+        void allocateBulk(Ptr* out, size_t n) {
+            size_t i = 0;
+            try {
+                while (i < n) {
+                    if (loaded_->empty()) reload();
+                    for (; i < n && !loaded_->empty(); ++i) {
+                        out[i] = static_cast<Ptr>(loaded_->pop());
+                    }
+                }
+            } catch (...) {
+                // the caller gets none of the chunks, the ones taken so far go back
+                deallocateBulk(out, i);
+                throw;
+            }
+        }
+
+        template <typename Ptr>
+        void deallocateBulk(Ptr* ptrs, size_t n) {
+            for (size_t i = 0; i < n;) {
+                if (loaded_->full()) unload();
+                for (; i < n && !loaded_->full(); ++i) {
+                    loaded_->push(ptrs[i]);
+                }
+            }
+        }
+    };
+
+    LockFreeStack<Magazine> full_;
+    LockFreeStack<Magazine> empty_;
+    std::atomic<size_t> depotChunks_{0};
+    SizeClassStats stats_{chunkSize};
+    std::atomic<size_t> highWater_{std::numeric_limits<size_t>::max()};
+    // raised after a trim() that could not get below highWater_, so that it does not rerun on every push
+    std::atomic<size_t> trimThreshold_{std::numeric_limits<size_t>::max()};
 
-    void resizeIfFull() {
-        if (lastIdx_ == 0) {
-            lastIdx_ = chunkSize * (1 << data_.size());
-            void* newPtr = ::operator new(lastIdx_);
-            data_.push_back(newPtr);
+    // blocks are only created and released on slow paths, a mutex is fine here
+    std::mutex blocksMutex_;
+    Block* blocks_ = nullptr;
+
+    Magazine* emptyMagazine() {
+        if (Magazine* magazine = empty_.pop()) return magazine;
+        return new Magazine();
+    }
+
+    Magazine* popFull() {
+        Magazine* magazine = full_.pop();
+        if (magazine != nullptr) {
+            depotChunks_.fetch_sub(magazine->count, std::memory_order_relaxed);
         }
+        return magazine;
+    }
+
+    // counted before the push: once published the magazine may be taken by another thread
+    size_t deposit(Magazine* magazine) {
+        size_t count = magazine->count;
+        size_t cached = depotChunks_.fetch_add(count, std::memory_order_relaxed) + count;
+        full_.push(magazine);
+        return cached;
+    }
+
+    void pushFull(Magazine* magazine) {
+        size_t cached = deposit(magazine);
+        if (cached * chunkSize > trimThreshold_.load(std::memory_order_relaxed)) {
+            trim();
+            size_t left = depotChunks_.load(std::memory_order_relaxed) * chunkSize;
+            size_t highWater = highWater_.load(std::memory_order_relaxed);
+            trimThreshold_.store(left > highWater / 2 ? std::max(highWater, 2 * left) : highWater,
+                                 std::memory_order_relaxed);
+        }
+    }
+
+    void release(Magazine* magazine) {
+        if (magazine->empty()) {
+            empty_.push(magazine);
+        } else {
+            pushFull(magazine);
+        }
+    }
+
+    Block* newBlock(size_t chunks) {
+        size_t size = (kHeaderSize + chunks * chunkSize + kPageSize - 1) / kPageSize * kPageSize;
+        Block* block = new (mapPages(size)) Block();
+        stats_.onMap(size);
+        block->size = size;
+        block->capacity = (size - kHeaderSize) / chunkSize;
+        std::lock_guard<std::mutex> lock(blocksMutex_);
+        block->next = blocks_;
+        blocks_ = block;
+        return block;
+    }
+
+    // nullptr once the cache of this thread is gone, e.g. for containers with static storage duration
+    static ThreadCache* cache() {
+        if (ThreadCache::destroyed) return nullptr;
+        thread_local ThreadCache cache(instance());
+        return &cache;
     }
 
     FixedAllocator() = default;
 
     ~FixedAllocator() {
-        for (auto* i : data_) {
-            ::operator delete(i);
+        while (Block* block = blocks_) {
+            blocks_ = block->next;
+            size_t size = block->size;
+            block->~Block();
+            unmapPages(block, size);
+        }
+        while (Magazine* magazine = full_.pop()) {
+            delete magazine;
+        }
+        while (Magazine* magazine = empty_.pop()) {
+            delete magazine;
         }
     }
 
@@ -38,33 +732,118 @@ public:
     }
 
     void* allocate() {
-        if (!unused_.empty()) {
-            auto ans = unused_.back();
-            unused_.pop_back();
-            return ans;
-        }
-        resizeIfFull();
-        char* rep = reinterpret_cast<char*>(data_.back());
-        lastIdx_ -= chunkSize;
-        auto ans = reinterpret_cast<void*>(rep + lastIdx_);
-        return ans;
+        stats_.onAllocate();
+        if (ThreadCache* threadCache = cache()) return threadCache->allocate();
+        return ::operator new(chunkSize, std::align_val_t(kDataAlignment));
     }
 
+    // after the thread cache is destroyed the chunk is leaked, the thread is exiting anyway
     void deallocate(void* ptr) {
-        unused_.push_back(ptr);
+        stats_.onDeallocate();
+        if (ThreadCache* threadCache = cache()) threadCache->deallocate(ptr);
+    }
+
+    // the same as n calls to allocate(), with one thread cache lookup
+    template <typename Ptr>
+    void allocateBulk(Ptr* out, size_t n) {
+        if (ThreadCache* threadCache = cache()) {
+            threadCache->allocateBulk(out, n);
+        } else {
+            for (size_t i = 0; i < n; ++i) {
+                try {
+                    out[i] = static_cast<Ptr>(::operator new(chunkSize, std::align_val_t(kDataAlignment)));
+                } catch (...) {
+                    while (i > 0) ::operator delete(out[--i], std::align_val_t(kDataAlignment));
+                    throw;
+                }
+            }
+        }
+        for (size_t i = 0; i < n; ++i) stats_.onAllocate();
+    }
+
+    template <typename Ptr>
+    void deallocateBulk(Ptr* ptrs, size_t n) {
+        for (size_t i = 0; i < n; ++i) stats_.onDeallocate();
+        if (ThreadCache* threadCache = cache()) threadCache->deallocateBulk(ptrs, n);
+    }
+
+    // Returns blocks whose chunks are all free in the depot to the OS, returns the number of bytes released.
+    // Chunks cached by threads are not looked at, so their blocks stay until a later trim().
+    size_t trim() {
+        std::unique_lock<std::mutex> lock(blocksMutex_, std::try_to_lock);
+        if (!lock.owns_lock()) return 0;
+
+        std::vector<void*> chunks;
+        while (Magazine* magazine = popFull()) {
+            while (!magazine->empty()) {
+                chunks.push_back(magazine->pop());
+            }
+            empty_.push(magazine);
+        }
+        std::sort(chunks.begin(), chunks.end(), std::less<void*>());
+        // kept aside rather than overwritten, so that chunks stays sorted for the searches below
+        std::vector<bool> unmapped(chunks.size(), false);
+
+        size_t released = 0;
+        Block** link = &blocks_;
+        while (Block* block = *link) {
+            if (block->sealed.load(std::memory_order_acquire)) {
+                void* begin = block->data();
+                void* end = block->data() + block->carved * chunkSize;
+                auto first = std::lower_bound(chunks.begin(), chunks.end(), begin, std::less<void*>());
+                auto last = std::lower_bound(first, chunks.end(), end, std::less<void*>());
+                if (static_cast<size_t>(last - first) == block->carved) {
+                    std::fill(unmapped.begin() + (first - chunks.begin()), unmapped.begin() + (last - chunks.begin()),
+                              true);
+                    *link = block->next;
+                    size_t size = block->size;
+                    stats_.onUnmap(size, block->carved);
+                    block->~Block();
+                    unmapPages(block, size);
+                    released += size;
+                    continue;
+                }
+            }
+            link = &block->next;
+        }
+
+        Magazine* magazine = nullptr;
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            if (unmapped[i]) continue;
+            if (magazine == nullptr) magazine = emptyMagazine();
+            magazine->push(chunks[i]);
+            if (magazine->full()) {
+                deposit(magazine);
+                magazine = nullptr;
+            }
+        }
+        if (magazine != nullptr) {
+            deposit(magazine);
+        }
+        return released;
+    }
+
+    // trim() automatically once the depot caches more than `bytes` of free chunks
+    void setHighWater(size_t bytes) {
+        highWater_.store(bytes, std::memory_order_relaxed);
+        trimThreshold_.store(bytes, std::memory_order_relaxed);
     }
 };
 
 template <typename T, size_t chunkSize = 8>
 struct allocateChunk {
     static T* allocate(size_t n) {
-        if constexpr (chunkSize > 64) {
-            return static_cast<T*>(::operator new(n * sizeof(T)));
+        if constexpr (chunkSize > kMaxChunkSize) {
+            if constexpr (alignof(T) > kPageSize) {
+                return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+            } else {
+                return static_cast<T*>(PageAllocator::instance().allocate(n * sizeof(T)));
+            }
         } else {
-            if (n * sizeof(T) <= chunkSize) {
+            if (fitsChunk<T>(n, chunkSize)) {
                 return static_cast<T*>(FixedAllocator<chunkSize>::instance().allocate());
             }
-            return allocateChunk<T, chunkSize + 8>::allocate(n);
+            return allocateChunk<T, nextChunkSize(chunkSize)>::allocate(n);
         }
     }
 };
@@ -72,16 +851,78 @@ struct allocateChunk {
 template <typename T, size_t chunkSize = 8>
 struct deallocateChunk {
     static void deallocate(void* ptr, size_t n) {
-        if constexpr (chunkSize > 64) {
-            return ::operator delete(ptr);
+        if constexpr (chunkSize > kMaxChunkSize) {
+            if constexpr (alignof(T) > kPageSize) {
+                return ::operator delete(ptr, std::align_val_t(alignof(T)));
+            } else {
+                return PageAllocator::instance().deallocate(ptr, n * sizeof(T));
+            }
         } else {
-            if (n * sizeof(T) <= chunkSize) {
+            if (fitsChunk<T>(n, chunkSize)) {
                 return FixedAllocator<chunkSize>::instance().deallocate(ptr);
             }
-            return deallocateChunk<T, chunkSize + 8>::deallocate(ptr, n);
+            return deallocateChunk<T, nextChunkSize(chunkSize)>::deallocate(ptr, n);
         }
     }
 };
+
+// allocate(1) / deallocate(ptr, 1) for many objects at once
+template <typename T, size_t chunkSize = 8>
+struct bulkChunks {
+    static void allocate(T** out, size_t n) {
+        if constexpr (chunkSize > kMaxChunkSize) {
+            for (size_t i = 0; i < n; ++i) {
+                try {
+                    out[i] = allocateChunk<T, chunkSize>::allocate(1);
+                } catch (...) {
+                    deallocate(out, i);
+                    throw;
+                }
+            }
+        } else {
+            if (fitsChunk<T>(1, chunkSize)) {
+                return FixedAllocator<chunkSize>::instance().allocateBulk(out, n);
+            }
+            return bulkChunks<T, nextChunkSize(chunkSize)>::allocate(out, n);
+        }
+    }
+
+    static void deallocate(T** ptrs, size_t n) {
+        if constexpr (chunkSize > kMaxChunkSize) {
+            for (size_t i = 0; i < n; ++i) {
+                deallocateChunk<T, chunkSize>::deallocate(ptrs[i], 1);
+            }
+        } else {
+            if (fitsChunk<T>(1, chunkSize)) {
+                return FixedAllocator<chunkSize>::instance().deallocateBulk(ptrs, n);
+            }
+            return bulkChunks<T, nextChunkSize(chunkSize)>::deallocate(ptrs, n);
+        }
+    }
+};
+
+// Every size class is constructed while this header's variables are initialized, so it is destroyed after
+// containers with static storage duration defined below the include, which may free into it during exit.
+template <size_t chunkSize = 8>
+void initChunks() {
+    if constexpr (chunkSize > kMaxChunkSize) {
+        PageAllocator::instance();
+    } else {
+        FixedAllocator<chunkSize>::instance();
+        initChunks<nextChunkSize(chunkSize)>();
+    }
+}
+
+inline const bool chunksInitialized = (initChunks(), true);
+
+template <size_t chunkSize = 8>
+size_t trimChunks() {
+    if constexpr (chunkSize > kMaxChunkSize) {
+        return PageAllocator::instance().trim();
+    } else {
+        return FixedAllocator<chunkSize>::instance().trim() + trimChunks<nextChunkSize(chunkSize)>();
+    }
+}
 }
 
 template <typename T>
@@ -98,12 +939,41 @@ public:
     FastAllocator(const FastAllocator<U>&): FastAllocator() {}
 
     T* allocate(size_t n) {
+        detail::StatsRegistry::instance().onRequest(n * sizeof(T));
         return detail::allocateChunk<T>::allocate(n);
     }
 
     void deallocate(T* ptr, size_t n) {
+        detail::StatsRegistry::instance().onRelease(n * sizeof(T));
         return detail::deallocateChunk<T>::deallocate(ptr, n);
     }
+
+    // n single objects, each to be freed by deallocate(ptr, 1) or deallocate_bulk
+    void allocate_bulk(T** out, size_t n) {
+        for (size_t i = 0; i < n; ++i) detail::StatsRegistry::instance().onRequest(sizeof(T));
+        detail::bulkChunks<T>::allocate(out, n);
+    }
+
+    void deallocate_bulk(T** ptrs, size_t n) {
+        for (size_t i = 0; i < n; ++i) detail::StatsRegistry::instance().onRelease(sizeof(T));
+        detail::bulkChunks<T>::deallocate(ptrs, n);
+    }
+
+    // gives fully free blocks of every size class back to the OS, returns the number of bytes released
+    static size_t trim() {
+        return detail::trimChunks();
+    }
+};
+
+// per size class counters, allocation size histogram and tags; see FAST_ALLOCATOR_STATS
+struct FastAllocatorStats {
+    static void dump(std::ostream& out) {
+        detail::StatsRegistry::instance().dump(out);
+    }
+
+    static void dumpJson(std::ostream& out) {
+        detail::StatsRegistry::instance().dumpJson(out);
+    }
 };
 
 template <typename T, typename U>
@@ -115,3 +985,126 @@ template <typename T, typename U>
 bool operator!=(const FastAllocator<T>& a, const FastAllocator<U>& b) {
     return !(a == b);
 }
+
+// Monotonic buffer: allocation is a pointer bump, deallocation does nothing,
+// memory comes back all at once by reset() or destruction.
+class Arena {
+private:
+    struct Block {
+        Block* next = nullptr;
+        size_t size = 0;
+    };
+
+    static constexpr size_t kHeaderSize = (sizeof(Block) + alignof(std::max_align_t) - 1)
+                                          / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+    Block* blocks_ = nullptr; // the latest one is the first
+    char* cursor_ = nullptr;
+    char* end_ = nullptr;
+    size_t nextBlockSize_;
+    size_t used_ = 0;
+
+    void grow(size_t bytes, size_t alignment) {
+        size_t size = std::max(nextBlockSize_, bytes + alignment);
+        nextBlockSize_ = std::max(nextBlockSize_, size) * 2;
+        char* rep = static_cast<char*>(::operator new(kHeaderSize + size));
+        blocks_ = new (rep) Block{blocks_, size};
+        cursor_ = rep + kHeaderSize;
+        end_ = cursor_ + size;
+    }
+
+    void releaseAfter(Block* block) {
+        while (Block* next = block->next) {
+            block->next = next->next;
+            ::operator delete(next);
+        }
+    }
+
+public:
+    explicit Arena(size_t initialSize = 4096): nextBlockSize_(initialSize) {}
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    ~Arena() {
+        if (blocks_ == nullptr) return;
+        releaseAfter(blocks_);
+        ::operator delete(blocks_);
+    }
+
+    void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t)) {
+        uintptr_t cursor = reinterpret_cast<uintptr_t>(cursor_);
+        uintptr_t aligned = (cursor + alignment - 1) / alignment * alignment;
+        if (cursor_ == nullptr || aligned + bytes > reinterpret_cast<uintptr_t>(end_)) {
+            grow(bytes, alignment);
+            return allocate(bytes, alignment);
+        }
+        used_ += aligned + bytes - cursor;
+        cursor_ = reinterpret_cast<char*>(aligned + bytes);
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    // An object created here is never destroyed: a container allocated by create() together with
+    // its ArenaAllocator is thrown away in O(1) by reset() if its elements are trivially destructible.
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // Invalidates everything allocated from the arena. The latest (and largest) block is kept,
+    // so an arena reset once per request stops calling ::operator new after a few requests.
+    void reset() {
+        if (blocks_ == nullptr) return;
+        releaseAfter(blocks_);
+        cursor_ = reinterpret_cast<char*>(blocks_) + kHeaderSize;
+        end_ = cursor_ + blocks_->size;
+        used_ = 0;
+    }
+
+    // bytes handed out since the last reset() including alignment padding
+    size_t used() const {
+        return used_;
+    }
+};
+
+template <typename T>
+class ArenaAllocator {
+private:
+    Arena* arena_;
+
+public:
+    using value_type = T;
+    using size_type = size_t;
+    using difference_type = ptrdiff_t;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    ArenaAllocator(Arena& arena): arena_(&arena) {}
+    ArenaAllocator(const ArenaAllocator<T>&) = default;
+    ~ArenaAllocator() = default;
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& that): arena_(&that.arena()) {}
+
+    ArenaAllocator<T>& operator=(const ArenaAllocator<T>&) = default;
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T*, size_t) {}
+
+    Arena& arena() const {
+        return *arena_;
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+    return &a.arena() == &b.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+    return !(a == b);
+}
@@ -0,0 +1,227 @@
+// Allocation pattern benchmark for FastAllocator against std::allocator and std::pmr pools.
+//
+//     g++ -std=c++17 -O2 -pthread fast_allocator_bench.cpp -o fast_allocator_bench
+//
+// Prints one tab-separated line per (pattern, object size, allocator):
+// ns per allocate+deallocate pair, RSS growth while the pattern's objects were live,
+// and that growth divided by the bytes requested (1.0 means no overhead, 0 means memory was reused).
+
+#include <random>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <memory_resource>
+#include <cstdio>
+#include <unistd.h>
+
+#include "bench.h"
+#include "fast_allocator.h"
+#include "list.h"
+
+// raw bytes, unlike the bench.h Object neither aligned nor initialized: only the allocation is measured
+template <size_t Size>
+struct Bytes {
+    char data[Size];
+};
+
+long RssKb() {
+    long pages = 0;
+    long resident = 0;
+    if (FILE* statm = std::fopen("/proc/self/statm", "r")) {
+        if (std::fscanf(statm, "%ld %ld", &pages, &resident) != 2) resident = 0;
+        std::fclose(statm);
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+struct Result {
+    double nsPerOp = 0;
+    long rssKb = 0;
+    size_t bytes = 0;
+};
+
+void Report(const char* pattern, size_t size, const char* allocator, const Result& result) {
+    double overhead = result.bytes ? result.rssKb * 1024.0 / result.bytes : 0;
+    std::printf("%s\t%zu\t%s\t%.2f\t%ld\t%.2f\n", pattern, size, allocator, result.nsPerOp, result.rssKb, overhead);
+}
+
+enum class Order {
+    Lifo,
+    Fifo,
+    Random,
+};
+
+template <typename Alloc>
+Result BenchBatch(Alloc alloc, size_t count, Order order) {
+    using T = typename Alloc::value_type;
+    std::vector<T*> ptrs(count);
+    std::vector<size_t> freeOrder(count);
+    for (size_t i = 0; i < count; ++i) {
+        freeOrder[i] = order == Order::Lifo ? count - 1 - i : i;
+    }
+    if (order == Order::Random) {
+        std::shuffle(freeOrder.begin(), freeOrder.end(), std::mt19937(42));
+    }
+
+    Result result;
+    long rssBefore = RssKb();
+    Timer timer;
+    for (size_t i = 0; i < count; ++i) {
+        ptrs[i] = alloc.allocate(1);
+        ptrs[i]->data[0] = static_cast<char>(i);
+    }
+    result.rssKb = RssKb() - rssBefore;
+    for (size_t i : freeOrder) {
+        alloc.deallocate(ptrs[i], 1);
+    }
+    result.nsPerOp = timer.nsPer(count);
+    result.bytes = count * sizeof(T);
+    return result;
+}
+
+// steady state: a working set of `live` objects where a random one is replaced on every step
+template <typename Alloc>
+Result BenchChurn(Alloc alloc, size_t live, size_t steps) {
+    using T = typename Alloc::value_type;
+    std::vector<T*> ptrs(live);
+    std::mt19937 gen(7);
+    Result result;
+    long rssBefore = RssKb();
+    for (auto& ptr : ptrs) ptr = alloc.allocate(1);
+    Timer timer;
+    for (size_t i = 0; i < steps; ++i) {
+        size_t victim = gen() % live;
+        alloc.deallocate(ptrs[victim], 1);
+        ptrs[victim] = alloc.allocate(1);
+    }
+    result.nsPerOp = timer.nsPer(steps);
+    result.rssKb = RssKb() - rssBefore;
+    result.bytes = live * sizeof(T);
+    for (auto* ptr : ptrs) alloc.deallocate(ptr, 1);
+    return result;
+}
+
+// one thread allocates, another frees, pointers cross in batches
+template <typename Alloc>
+Result BenchProducerConsumer(Alloc alloc, size_t count) {
+    using T = typename Alloc::value_type;
+    const size_t kBatch = 256;
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::vector<std::vector<T*>> queue;
+    bool done = false;
+
+    Timer timer;
+    std::thread consumer([&] {
+        while (true) {
+            std::vector<std::vector<T*>> batches;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [&] { return done || !queue.empty(); });
+                if (queue.empty() && done) return;
+                batches.swap(queue);
+            }
+            for (auto& batch : batches) {
+                for (T* ptr : batch) alloc.deallocate(ptr, 1);
+            }
+        }
+    });
+    std::vector<T*> batch;
+    for (size_t i = 0; i < count; ++i) {
+        batch.push_back(alloc.allocate(1));
+        if (batch.size() == kBatch || i + 1 == count) {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(std::move(batch));
+            batch.clear();
+            ready.notify_one();
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+        ready.notify_one();
+    }
+    consumer.join();
+
+    Result result;
+    result.nsPerOp = timer.nsPer(count);
+    return result;
+}
+
+template <typename T, typename Alloc>
+Result BenchList(Alloc alloc, size_t count) {
+    Result result;
+    long rssBefore = RssKb();
+    Timer timer;
+    {
+        List<T, Alloc> list(alloc);
+        for (size_t i = 0; i < count; ++i) {
+            list.push_back(T());
+        }
+        result.rssKb = RssKb() - rssBefore;
+    }
+    result.nsPerOp = timer.nsPer(count);
+    result.bytes = count * sizeof(T);
+    return result;
+}
+
+template <size_t Size>
+void BenchSize(size_t count) {
+    using T = Bytes<Size>;
+    const char* kStd = "std::allocator";
+    const char* kFast = "FastAllocator";
+    const char* kPool = "pmr::unsynchronized_pool";
+
+    const std::pair<const char*, Order> orders[] = {
+        {"lifo", Order::Lifo},
+        {"fifo", Order::Fifo},
+        {"random", Order::Random},
+    };
+    for (auto& [name, order] : orders) {
+        Report(name, Size, kStd, BenchBatch(std::allocator<T>(), count, order));
+        Report(name, Size, kFast, BenchBatch(FastAllocator<T>(), count, order));
+        FastAllocator<T>::trim();
+        std::pmr::unsynchronized_pool_resource pool;
+        Report(name, Size, kPool, BenchBatch(std::pmr::polymorphic_allocator<T>(&pool), count, order));
+    }
+
+    Report("churn", Size, kStd, BenchChurn(std::allocator<T>(), count / 10, count));
+    Report("churn", Size, kFast, BenchChurn(FastAllocator<T>(), count / 10, count));
+    {
+        std::pmr::unsynchronized_pool_resource pool;
+        Report("churn", Size, kPool, BenchChurn(std::pmr::polymorphic_allocator<T>(&pool), count / 10, count));
+    }
+
+    // an unsynchronized pool cannot be shared between threads, the synchronized one stands in for it
+    Report("producer-consumer", Size, kStd, BenchProducerConsumer(std::allocator<T>(), count));
+    Report("producer-consumer", Size, kFast, BenchProducerConsumer(FastAllocator<T>(), count));
+    {
+        std::pmr::synchronized_pool_resource pool;
+        Report("producer-consumer", Size, "pmr::synchronized_pool",
+               BenchProducerConsumer(std::pmr::polymorphic_allocator<T>(&pool), count));
+    }
+
+    Report("list", Size, kStd, BenchList<T>(std::allocator<T>(), count));
+    Report("list", Size, kFast, BenchList<T>(FastAllocator<T>(), count));
+    {
+        std::pmr::unsynchronized_pool_resource pool;
+        Report("list", Size, kPool, BenchList<T>(std::pmr::polymorphic_allocator<T>(&pool), count));
+    }
+    FastAllocator<T>::trim();
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::stoul(argv[1]) : 1'000'000;
+    std::printf("pattern\tsize\tallocator\tns/op\trss_kb\trss/bytes\n");
+    BenchSize<8>(count);
+    BenchSize<16>(count);
+    BenchSize<32>(count);
+    BenchSize<64>(count);
+    BenchSize<128>(count);
+    BenchSize<256>(count);
+    BenchSize<1024>(count / 4);
+    BenchSize<4096>(count / 16);
+}
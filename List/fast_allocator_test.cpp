@@ -0,0 +1,273 @@
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <fstream>
+#include <cassert>
+#include "fast_allocator.h"
+#include "list.h"
+
+// fills the object with a pattern derived from its tag, so a chunk handed out twice is noticed
+template <size_t padding>
+struct Payload {
+    size_t tag = 0;
+    unsigned char bytes[padding];
+
+    void stamp(size_t t) {
+        tag = t;
+        for (auto& byte : bytes) byte = static_cast<unsigned char>(t);
+    }
+
+    bool intact() const {
+        for (auto byte : bytes) {
+            if (byte != static_cast<unsigned char>(tag)) return false;
+        }
+        return true;
+    }
+};
+
+// Every thread allocates chunks and mails them to the next thread, which checks and frees them, so almost
+// every chunk is freed by a thread that did not allocate it and travels back through the magazine depot.
+template <size_t padding>
+void CrossThreadFreeTest(int threads, int rounds, size_t batch) {
+    using T = Payload<padding>;
+    struct Mailbox {
+        std::mutex mutex;
+        std::vector<T*> items;
+    };
+    std::vector<Mailbox> mailboxes(threads);
+    std::atomic<size_t> freed{0};
+
+    auto freeAll = [&freed](std::vector<T*>& items, bool bulk) {
+        FastAllocator<T> alloc;
+        for (T* item : items) {
+            assert(item->intact());
+            item->stamp(0);
+        }
+        if (bulk) {
+            alloc.deallocate_bulk(items.data(), items.size());
+        } else {
+            for (T* item : items) alloc.deallocate(item, 1);
+        }
+        freed.fetch_add(items.size());
+        items.clear();
+    };
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            FastAllocator<T> alloc;
+            std::vector<T*> mine(batch);
+            std::vector<T*> received;
+            for (int r = 0; r < rounds; ++r) {
+                if (r % 2 == 0) {
+                    alloc.allocate_bulk(mine.data(), batch);
+                } else {
+                    for (auto& item : mine) item = alloc.allocate(1);
+                }
+                for (size_t i = 0; i < batch; ++i) {
+                    mine[i]->stamp((static_cast<size_t>(t) * rounds + r) * batch + i + 1);
+                }
+                {
+                    Mailbox& next = mailboxes[(t + 1) % threads];
+                    std::lock_guard<std::mutex> lock(next.mutex);
+                    next.items.insert(next.items.end(), mine.begin(), mine.end());
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mailboxes[t].mutex);
+                    received.swap(mailboxes[t].items);
+                }
+                freeAll(received, r % 3 == 0);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    for (auto& mailbox : mailboxes) {
+        freeAll(mailbox.items, true);
+    }
+    assert(freed.load() == static_cast<size_t>(threads) * rounds * batch);
+}
+
+struct StackNode {
+    std::atomic<StackNode*> next{nullptr};
+    std::atomic<int> owners{0};
+};
+
+// threads keep popping a node and pushing it back; a node that two threads hold at once means an ABA slip
+void LockFreeStackTest(int threads, int rounds) {
+    const int kNodes = 64;
+    std::vector<StackNode> nodes(kNodes);
+    detail::LockFreeStack<StackNode> stack;
+    for (auto& node : nodes) {
+        stack.push(&node);
+    }
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            std::vector<StackNode*> held;
+            for (int r = 0; r < rounds; ++r) {
+                for (int i = 0; i < 3; ++i) {
+                    if (StackNode* node = stack.pop()) {
+                        assert(node->owners.fetch_add(1) == 0);
+                        held.push_back(node);
+                    }
+                }
+                while (!held.empty()) {
+                    held.back()->owners.fetch_sub(1);
+                    stack.push(held.back());
+                    held.pop_back();
+                }
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    int count = 0;
+    while (StackNode* node = stack.pop()) {
+        assert(node->owners.load() == 0);
+        ++count;
+    }
+    assert(count == kNodes);
+}
+
+// resident set size in bytes, 0 where /proc is not available
+size_t ResidentBytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0;
+    size_t resident = 0;
+    statm >> pages >> resident;
+    return resident * detail::kPageSize;
+}
+
+// freed chunks that reach the depot let trim() unmap their blocks, and the memory leaves the process
+void TrimTest() {
+    using T = Payload<248>;
+    const size_t kCount = 100'000;
+    FastAllocator<T> alloc;
+    std::vector<T*> items(kCount);
+    for (auto& item : items) {
+        item = alloc.allocate(1);
+        item->stamp(1);
+    }
+    size_t bytes = kCount * sizeof(T);
+    size_t before = ResidentBytes();
+
+    for (T* item : items) {
+        alloc.deallocate(item, 1);
+    }
+    size_t released = FastAllocator<T>::trim();
+    // all but the current block and the chunks held by this thread's magazines go back;
+    // trim() covers every size class, so blocks left by earlier tests may add to it
+    assert(released >= bytes * 9 / 10);
+    if (before != 0) {
+        assert(ResidentBytes() + released / 2 <= before);
+    }
+    assert(FastAllocator<T>::trim() == 0);
+
+    // the allocator keeps working with fresh blocks
+    for (auto& item : items) {
+        item = alloc.allocate(1);
+        item->stamp(2);
+    }
+    for (T* item : items) {
+        assert(item->intact());
+        alloc.deallocate(item, 1);
+    }
+    FastAllocator<T>::trim();
+}
+
+// frees from thread_local objects destroyed after the thread cache go nowhere, without crashing
+void FreeAfterCacheTeardownTest() {
+    using T = Payload<56>;
+    struct Holder {
+        std::vector<T*> items;
+
+        ~Holder() {
+            FastAllocator<T> alloc;
+            for (T* item : items) {
+                assert(item->intact());
+                alloc.deallocate(item, 1);
+            }
+            alloc.deallocate_bulk(items.data(), 0);
+        }
+    };
+
+    std::thread thread([] {
+        // constructed before the cache of this size class, so destroyed after it
+        thread_local Holder holder;
+        FastAllocator<T> alloc;
+        for (int i = 0; i < 100; ++i) {
+            holder.items.push_back(alloc.allocate(1));
+            holder.items.back()->stamp(i);
+        }
+    });
+    thread.join();
+}
+
+// a List whose nodes come from an arena; reset() throws the nodes away and the next round reuses the memory
+void ArenaListTest() {
+    using ArenaList = List<long long, ArenaAllocator<long long>>;
+    Arena arena(256);
+    assert(arena.used() == 0);
+
+    std::vector<const long long*> addresses[2];
+    for (int round = 0; round < 4; ++round) {
+        {
+            ArenaAllocator<long long> alloc(arena);
+            // created in the arena too, so neither the list nor its nodes are ever destroyed;
+            // the copy is an ordinary object and has to go before reset()
+            ArenaList* list = arena.create<ArenaList>(alloc);
+            for (long long i = 0; i < 1000; ++i) {
+                if (i % 2 == 0) {
+                    list->push_back(i);
+                } else {
+                    list->push_front(i);
+                }
+            }
+            ArenaList copy = *list;
+            assert(copy.get_allocator() == alloc);
+            copy.pop_front();
+            list->pop_back();
+
+            assert(list->size() == 999 && copy.size() == 999);
+            long long sum = 0;
+            for (const long long& value : *list) {
+                sum += value;
+            }
+            assert(sum == 999 * 1000 / 2 - 998);
+            assert(arena.used() >= 2 * 1000 * sizeof(long long));
+
+            // after the first round the arena has grown enough, so every round gets the same memory
+            if (round >= 2) {
+                std::vector<const long long*>& seen = addresses[round % 2];
+                for (const long long& value : copy) {
+                    seen.push_back(&value);
+                }
+                if (round == 3) {
+                    assert(addresses[0] == addresses[1]);
+                }
+            }
+        }
+        arena.reset();
+        assert(arena.used() == 0);
+    }
+}
+
+int main() {
+    LockFreeStackTest(4, 20'000);
+
+    CrossThreadFreeTest<8>(4, 300, 50);
+    CrossThreadFreeTest<120>(4, 300, 50);
+    CrossThreadFreeTest<1000>(3, 200, 20);
+    CrossThreadFreeTest<8>(2, 1000, 1);
+
+    TrimTest();
+    FreeAfterCacheTeardownTest();
+
+    ArenaListTest();
+}
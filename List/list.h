@@ -1,22 +1,35 @@
 #pragma once
 #include <memory>
 #include <iterator>
+#include <limits>
+#include <optional>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
 
 template <typename T, typename Alloc = std::allocator<T>>
 class List {
-    struct Node {
-        T value = T();
-        Node* prev = nullptr;
-        Node* next = nullptr;
-        Node() = default;
-        Node(const T& value, Node* prev = nullptr, Node* next = nullptr): value(value), prev(prev), next(next) {}
-        Node(T&& value, Node* prev = nullptr, Node* next = nullptr): value(std::move(value)), prev(prev), next(next) {}
+    struct NodeBase {
+        NodeBase* prev = nullptr;
+        NodeBase* next = nullptr;
     };
 
+    // the value is built in place from the arguments, no arguments means value-initialized
+    struct Node: NodeBase {
+        T value;
+
+        template <typename... Args>
+        explicit Node(Args&&... args): value(std::forward<Args>(args)...) {}
+    };
+
+    static Node* asNode(NodeBase* base) {
+        return static_cast<Node*>(base);
+    }
+
     template <bool isConst>
     class iterator_impl {
     private:
-        Node* current = nullptr;
+        NodeBase* current = nullptr;
 
     public:
         using iterator_category = std::bidirectional_iterator_tag;
@@ -62,11 +75,11 @@ class List {
         }
 
         reference operator*() const {
-            return current->value;
+            return asNode(current)->value;
         }
 
         pointer operator->() const {
-            return &(current->value);
+            return &asNode(current)->value;
         }
 
         friend bool operator==(const iterator_impl<isConst>& a, const iterator_impl<isConst>& b) {
@@ -78,138 +91,401 @@ class List {
         }
 
         protected:
-            iterator_impl(Node* t): current(t) {}
+            iterator_impl(NodeBase* t): current(t) {}
 
             friend class List<T, Alloc>;
     };
 
     Alloc alloc_;
     typename std::allocator_traits<Alloc>::template rebind_alloc<Node> allocNode_;
-    Node* buf_;
+    NodeBase sentinel_; // stored inline, so it has to be relinked on move and swap
     size_t size_ = 0;
     using Traits = std::allocator_traits<Alloc>;
     using TraitsNode = typename std::allocator_traits<Alloc>::template rebind_traits<Node>;
 
-    void insertBefore(Node* element, const T& value) {
-        Node* nvalue = TraitsNode::allocate(allocNode_, 1);
-        TraitsNode::construct(allocNode_, nvalue, value, element->prev, element);
-        linkBefore(element, nvalue);
+    template <typename... Args>
+    Node* emplaceBefore(NodeBase* element, Args&&... args) {
+        Node* node = TraitsNode::allocate(allocNode_, 1);
+        try {
+            TraitsNode::construct(allocNode_, node, std::forward<Args>(args)...);
+        } catch (...) {
+            TraitsNode::deallocate(allocNode_, node, 1);
+            throw;
+        }
+        linkBefore(element, node);
+        ++size_;
+        return node;
     }
 
-    void linkBefore(Node* element, Node* value) {
+    static void linkBefore(NodeBase* element, NodeBase* value) {
         value->next = element;
         value->prev = element->prev;
         element->prev->next = value;
         element->prev = value;
     }
 
-    void eraseBefore(Node* element) {
-        Node* trash = cutBefore(element);
+    void eraseBefore(NodeBase* element) {
+        Node* trash = asNode(cutBefore(element));
         TraitsNode::destroy(allocNode_, trash);
         TraitsNode::deallocate(allocNode_, trash, 1);
+        --size_;
     }
 
-    Node* cutBefore(Node* element) {
-        Node* trash = element->prev;
+    static NodeBase* cutBefore(NodeBase* element) {
+        NodeBase* trash = element->prev;
         trash->prev->next = element;
         element->prev = trash->prev;
         return trash;
     }
 
-    void constructBuf() {
-        buf_ = TraitsNode::allocate(allocNode_, 1);
-        buf_->next = buf_;
-        buf_->prev = buf_;
+    // an allocator may provide allocate_bulk(T** out, size_t n) and deallocate_bulk(T** ptrs, size_t n)
+    // to hand out and take back many single objects in one call
+    template <typename A, typename = void>
+    struct hasBulk: std::false_type {};
+
+    template <typename A>
+    struct hasBulk<A, std::void_t<decltype(std::declval<A&>().allocate_bulk(std::declval<Node**>(), size_t())),
+                                  decltype(std::declval<A&>().deallocate_bulk(std::declval<Node**>(), size_t()))>>:
+            std::true_type {};
+
+    // without bulk calls nodes are allocated and freed one by one, batching would only delay the frees
+    static constexpr size_t kBatch = hasBulk<decltype(allocNode_)>::value ? 64 : 1;
+
+    void allocateNodes(Node** nodes, size_t n) {
+        if constexpr (hasBulk<decltype(allocNode_)>::value) {
+            allocNode_.allocate_bulk(nodes, n);
+        } else {
+            for (size_t i = 0; i < n; ++i) {
+                nodes[i] = TraitsNode::allocate(allocNode_, 1);
+            }
+        }
+    }
+
+    void deallocateNodes(Node** nodes, size_t n) {
+        if (n == 0) return;
+        if constexpr (hasBulk<decltype(allocNode_)>::value) {
+            allocNode_.deallocate_bulk(nodes, n);
+        } else {
+            for (size_t i = 0; i < n; ++i) {
+                TraitsNode::deallocate(allocNode_, nodes[i], 1);
+            }
+        }
+    }
+
+    // destroys a nullptr-terminated chain
+    void destroyChain(NodeBase* head) {
+        Node* batch[kBatch];
+        size_t n = 0;
+        while (head != nullptr) {
+            NodeBase* next = head->next;
+            Node* node = asNode(head);
+            TraitsNode::destroy(allocNode_, node);
+            batch[n++] = node;
+            if (n == kBatch) {
+                deallocateNodes(batch, n);
+                n = 0;
+            }
+            head = next;
+        }
+        deallocateNodes(batch, n);
+    }
+
+    // `construct(Node*)` builds the next node in raw memory and returns true, or returns false when the source
+    // is exhausted. Up to `limit` nodes are allocated kBatch at a time and linked into a detached chain,
+    // which is put before pos at the end, so on exception the list stays untouched.
+    template <typename Construct>
+    NodeBase* insertBatched(NodeBase* pos, size_t limit, Construct construct) {
+        NodeBase* head = nullptr;
+        NodeBase* tail = nullptr;
+        size_t count = 0;
+        Node* batch[kBatch];
+        size_t allocated = 0;
+        size_t built = 0;
+        try {
+            while (count < limit) {
+                size_t n = std::min(kBatch, limit - count);
+                built = 0;
+                allocateNodes(batch, n);
+                allocated = n;
+                for (; built < n && construct(batch[built]); ++built) {
+                    Node* node = batch[built];
+                    node->prev = tail;
+                    node->next = nullptr;
+                    (tail != nullptr ? tail->next : head) = node;
+                    tail = node;
+                }
+                deallocateNodes(batch + built, n - built);
+                allocated = 0;
+                count += built;
+                if (built < n) break;
+            }
+        } catch (...) {
+            deallocateNodes(batch + built, allocated - built);
+            destroyChain(head);
+            throw;
+        }
+        if (head == nullptr) return pos;
+        head->prev = pos->prev;
+        pos->prev->next = head;
+        tail->next = pos;
+        pos->prev = tail;
+        size_ += count;
+        return head;
+    }
+
+    template <typename InputIt>
+    NodeBase* insertRange(NodeBase* pos, InputIt first, InputIt last) {
+        size_t limit = std::numeric_limits<size_t>::max();
+        if constexpr (std::is_base_of_v<std::forward_iterator_tag,
+                                        typename std::iterator_traits<InputIt>::iterator_category>) {
+            limit = std::distance(first, last);
+        }
+        return insertBatched(pos, limit, [&](Node* node) {
+            if (first == last) return false;
+            TraitsNode::construct(allocNode_, node, *first);
+            try {
+                ++first;
+            } catch (...) {
+                // the node is not counted as built, insertBatched would only free its memory
+                TraitsNode::destroy(allocNode_, node);
+                throw;
+            }
+            return true;
+        });
+    }
+
+    // unlinks [first, last) and links it before pos, pos must not be inside the range
+    static void transfer(NodeBase* pos, NodeBase* first, NodeBase* last) {
+        if (first == last || pos == first || pos == last) return;
+        NodeBase* tail = last->prev;
+        first->prev->next = last;
+        last->prev = first->prev;
+        tail->next = pos;
+        first->prev = pos->prev;
+        pos->prev->next = first;
+        pos->prev = tail;
+    }
+
+    // erases everything before pos
+    void dropBefore(NodeBase* pos) {
+        if (pos == sentinel_.next) return;
+        NodeBase* head = sentinel_.next;
+        for (NodeBase* it = head; it != pos; it = it->next) {
+            --size_;
+        }
+        pos->prev->next = nullptr;
+        sentinel_.next = pos;
+        pos->prev = &sentinel_;
+        destroyChain(head);
+    }
+
+    void resetSentinel() {
+        sentinel_.prev = &sentinel_;
+        sentinel_.next = &sentinel_;
+    }
+
+    // takes the nodes of `that`, whose sentinel is reset
+    void adopt(NodeBase& that) {
+        if (that.next == &that) {
+            resetSentinel();
+            return;
+        }
+        sentinel_.next = that.next;
+        sentinel_.prev = that.prev;
+        sentinel_.next->prev = &sentinel_;
+        sentinel_.prev->next = &sentinel_;
+        that.next = &that;
+        that.prev = &that;
+    }
+
+    // the nodes of a list as a nullptr-terminated chain, prev links are not maintained
+    NodeBase* detachChain() {
+        if (empty()) return nullptr;
+        NodeBase* head = sentinel_.next;
+        sentinel_.prev->next = nullptr;
+        resetSentinel();
+        return head;
+    }
+
+    void attachChain(NodeBase* head) {
+        NodeBase* prev = &sentinel_;
+        for (NodeBase* it = head; it != nullptr; it = it->next) {
+            it->prev = prev;
+            prev->next = it;
+            prev = it;
+        }
+        prev->next = &sentinel_;
+        sentinel_.prev = prev;
     }
 
-    void destroyBuf() {
-        TraitsNode::deallocate(allocNode_, buf_, 1);
+    // cuts the chain after n nodes and returns the rest
+    static NodeBase* cutChain(NodeBase* head, size_t n) {
+        for (size_t i = 1; head != nullptr && i < n; ++i) {
+            head = head->next;
+        }
+        if (head == nullptr) return nullptr;
+        NodeBase* rest = head->next;
+        head->next = nullptr;
+        return rest;
+    }
+
+    // stable merge of sorted chains appended to *tail, returns the link after the last node
+    template <typename Compare>
+    static NodeBase** mergeChains(NodeBase* a, NodeBase* b, NodeBase** tail, Compare& comp) {
+        while (a != nullptr && b != nullptr) {
+            if (comp(asNode(b)->value, asNode(a)->value)) {
+                *tail = b;
+                b = b->next;
+            } else {
+                *tail = a;
+                a = a->next;
+            }
+            tail = &(*tail)->next;
+        }
+        *tail = (a != nullptr ? a : b);
+        while (*tail != nullptr) {
+            tail = &(*tail)->next;
+        }
+        return tail;
     }
 
 public:
     explicit List(const Alloc& alloc = Alloc()): alloc_(alloc), allocNode_(alloc) {
-        constructBuf();
+        resetSentinel();
     }
 
-    List(size_t n, const Alloc& alloc = Alloc()): alloc_(alloc) {
-        constructBuf();
-        size_ = n;
-        for (size_t i = 0; i < n; ++i) {
-            Node* newNode = TraitsNode::allocate(allocNode_, 1);
-            TraitsNode::construct(allocNode_, newNode);
-            linkBefore(buf_, newNode);
-        }
+    List(size_t n, const Alloc& alloc = Alloc()): List(alloc) {
+        insertBatched(&sentinel_, n, [this](Node* node) {
+            TraitsNode::construct(allocNode_, node);
+            return true;
+        });
     }
 
     List(size_t n, const T& value, const Alloc& alloc = Alloc()): List(alloc) {
-        for (size_t i = 0; i < n; ++i) {
-            push_back(value);
-        }
+        insertBatched(&sentinel_, n, [this, &value](Node* node) {
+            TraitsNode::construct(allocNode_, node, value);
+            return true;
+        });
+    }
+
+    template <typename InputIt, typename = typename std::iterator_traits<InputIt>::iterator_category>
+    List(InputIt first, InputIt last, const Alloc& alloc = Alloc()): List(alloc) {
+        insertRange(&sentinel_, first, last);
     }
 
     List(const List<T, Alloc>& list):
-            alloc_(Traits::select_on_container_copy_construction(list.alloc_)),
-            allocNode_(TraitsNode::select_on_container_copy_construction(list.allocNode_)) {
-        constructBuf();
-        for (auto it = list.cbegin(); it != list.cend(); ++it) {
-            push_back(*it);
-        }
+            List(Traits::select_on_container_copy_construction(list.alloc_)) {
+        insertRange(&sentinel_, list.begin(), list.end());
+    }
+
+    List(List<T, Alloc>&& list) noexcept: alloc_(list.alloc_), allocNode_(list.allocNode_), size_(list.size_) {
+        adopt(list.sentinel_);
+        list.size_ = 0;
     }
 
     List& operator=(const List<T, Alloc>& list) {
         if (this == &list) return *this;
         clear();
-        if (TraitsNode::propagate_on_container_copy_assignment::value && alloc_ != list.alloc_) {
-            destroyBuf();
+        if constexpr (TraitsNode::propagate_on_container_copy_assignment::value) {
             alloc_ = list.alloc_;
             allocNode_ = list.allocNode_;
-            constructBuf();
         }
-        for (auto& it : list) {
-            push_back(it);
+        insertRange(&sentinel_, list.begin(), list.end());
+        return *this;
+    }
+
+    // steals the nodes unless the allocators differ and do not propagate, then moves element by element
+    List& operator=(List<T, Alloc>&& list) noexcept(TraitsNode::propagate_on_container_move_assignment::value ||
+                                                    TraitsNode::is_always_equal::value) {
+        if (this == &list) return *this;
+        if constexpr (TraitsNode::propagate_on_container_move_assignment::value) {
+            clear();
+            alloc_ = list.alloc_;
+            allocNode_ = list.allocNode_;
+        } else if (allocNode_ != list.allocNode_) {
+            assign(std::make_move_iterator(list.begin()), std::make_move_iterator(list.end()));
+            return *this;
+        } else {
+            clear();
         }
+        adopt(list.sentinel_);
+        size_ = list.size_;
+        list.size_ = 0;
         return *this;
     }
 
     ~List() {
         clear();
-        destroyBuf();
+    }
+
+    // iterators stay valid except end()
+    void swap(List<T, Alloc>& that) noexcept {
+        if (this == &that) return;
+        using std::swap;
+        NodeBase mine;
+        mine.next = &mine;
+        mine.prev = &mine;
+        if (sentinel_.next != &sentinel_) {
+            mine.next = sentinel_.next;
+            mine.prev = sentinel_.prev;
+            mine.next->prev = &mine;
+            mine.prev->next = &mine;
+        }
+        adopt(that.sentinel_);
+        that.adopt(mine);
+        swap(alloc_, that.alloc_);
+        swap(allocNode_, that.allocNode_);
+        swap(size_, that.size_);
     }
 
     void push_front(const T& value) {
-        ++size_;
-        insertBefore(buf_->next, value);
+        emplaceBefore(sentinel_.next, value);
+    }
+
+    void push_front(T&& value) {
+        emplaceBefore(sentinel_.next, std::move(value));
     }
 
     void push_back(const T& value) {
-        ++size_;
-        insertBefore(buf_, value);
+        emplaceBefore(&sentinel_, value);
+    }
+
+    void push_back(T&& value) {
+        emplaceBefore(&sentinel_, std::move(value));
+    }
+
+    template <typename... Args>
+    T& emplace_front(Args&&... args) {
+        return emplaceBefore(sentinel_.next, std::forward<Args>(args)...)->value;
+    }
+
+    template <typename... Args>
+    T& emplace_back(Args&&... args) {
+        return emplaceBefore(&sentinel_, std::forward<Args>(args)...)->value;
     }
 
     void pop_back() {
-        --size_;
-        eraseBefore(buf_);
+        eraseBefore(&sentinel_);
     }
 
     void pop_front() {
-        --size_;
-        eraseBefore(buf_->next->next);
+        eraseBefore(sentinel_.next->next);
     }
 
     T& back() {
-        return buf_->prev->value;
+        return asNode(sentinel_.prev)->value;
     }
 
     const T& back() const {
-        return buf_->prev->value;
+        return asNode(sentinel_.prev)->value;
     }
 
     T& front() {
-        return buf_->next->value;
+        return asNode(sentinel_.next)->value;
     }
 
     const T& front() const {
-        return buf_->next->value;
+        return asNode(sentinel_.next)->value;
     }
 
     size_t size() const {
@@ -217,7 +493,8 @@ public:
     }
 
     void clear() {
-        while (!empty()) pop_back();
+        destroyChain(detachChain());
+        size_ = 0;
     }
 
     bool empty() const {
@@ -237,20 +514,194 @@ public:
     using reverse_iterator = std::reverse_iterator<iterator>;
 
     void insert(const_iterator pos, const T& value) {
-        ++size_;
-        insertBefore(pos.current, value);
+        emplaceBefore(pos.current, value);
+    }
+
+    void insert(const_iterator pos, T&& value) {
+        emplaceBefore(pos.current, std::move(value));
+    }
+
+    template <typename... Args>
+    iterator emplace(const_iterator pos, Args&&... args) {
+        return iterator(emplaceBefore(pos.current, std::forward<Args>(args)...));
+    }
+
+    // returns the first inserted element, or pos if the range is empty
+    template <typename InputIt, typename = typename std::iterator_traits<InputIt>::iterator_category>
+    iterator insert(const_iterator pos, InputIt first, InputIt last) {
+        return iterator(insertRange(pos.current, first, last));
+    }
+
+    iterator insert(const_iterator pos, size_t n, const T& value) {
+        return iterator(insertBatched(pos.current, n, [this, &value](Node* node) {
+            TraitsNode::construct(allocNode_, node, value);
+            return true;
+        }));
+    }
+
+    // the new elements are built before the old ones are dropped, so on exception nothing changes
+    template <typename InputIt, typename = typename std::iterator_traits<InputIt>::iterator_category>
+    void assign(InputIt first, InputIt last) {
+        dropBefore(insertRange(&sentinel_, first, last));
+    }
+
+    void assign(size_t n, const T& value) {
+        dropBefore(insert(end(), n, value).current);
     }
 
     iterator erase(const_iterator pos) {
-        --size_;
         ++pos;
         iterator ans(pos.current);
         eraseBefore(pos.current);
         return ans;
     }
 
+    // owns a node extracted from a List, can be inserted into any List with an equal allocator
+    class node_type {
+    private:
+        using NodeAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Node>;
+
+        Node* node_ = nullptr;
+        std::optional<NodeAlloc> allocNode_;
+
+        node_type(Node* node, const NodeAlloc& allocNode): node_(node), allocNode_(allocNode) {}
+
+        friend class List<T, Alloc>;
+
+    public:
+        node_type() = default;
+
+        node_type(node_type&& that): node_(that.node_), allocNode_(std::move(that.allocNode_)) {
+            that.node_ = nullptr;
+        }
+
+        node_type& operator=(node_type&& that) {
+            node_type tmp(std::move(that));
+            std::swap(node_, tmp.node_);
+            std::swap(allocNode_, tmp.allocNode_);
+            return *this;
+        }
+
+        ~node_type() {
+            if (node_ == nullptr) return;
+            TraitsNode::destroy(*allocNode_, node_);
+            TraitsNode::deallocate(*allocNode_, node_, 1);
+        }
+
+        bool empty() const {
+            return node_ == nullptr;
+        }
+
+        explicit operator bool() const {
+            return !empty();
+        }
+
+        T& value() const {
+            return node_->value;
+        }
+
+        Alloc get_allocator() const {
+            return Alloc(*allocNode_);
+        }
+    };
+
+    node_type extract(const_iterator pos) {
+        --size_;
+        Node* node = asNode(cutBefore(pos.current->next));
+        return node_type(node, allocNode_);
+    }
+
+    iterator insert(const_iterator pos, node_type&& node) {
+        if (node.empty()) return end();
+        ++size_;
+        linkBefore(pos.current, node.node_);
+        iterator ans(node.node_);
+        node.node_ = nullptr;
+        return ans;
+    }
+
+    // splice and merge only relink nodes, so both lists must have equal allocators
+    void splice(const_iterator pos, List<T, Alloc>& other) {
+        if (this == &other) return;
+        size_ += other.size_;
+        other.size_ = 0;
+        transfer(pos.current, other.sentinel_.next, &other.sentinel_);
+    }
+
+    void splice(const_iterator pos, List<T, Alloc>&& other) {
+        splice(pos, other);
+    }
+
+    void splice(const_iterator pos, List<T, Alloc>& other, const_iterator it) {
+        if (pos == it || pos.current == it.current->next) return;
+        --other.size_;
+        ++size_;
+        transfer(pos.current, it.current, it.current->next);
+    }
+
+    void splice(const_iterator pos, List<T, Alloc>&& other, const_iterator it) {
+        splice(pos, other, it);
+    }
+
+    // linear in the length of the range when other is a different list
+    void splice(const_iterator pos, List<T, Alloc>& other, const_iterator first, const_iterator last) {
+        if (this != &other) {
+            size_t n = std::distance(first, last);
+            other.size_ -= n;
+            size_ += n;
+        }
+        transfer(pos.current, first.current, last.current);
+    }
+
+    void splice(const_iterator pos, List<T, Alloc>&& other, const_iterator first, const_iterator last) {
+        splice(pos, other, first, last);
+    }
+
+    // both lists must be sorted, equal elements of this list go first
+    template <typename Compare>
+    void merge(List<T, Alloc>& other, Compare comp) {
+        if (this == &other || other.empty()) return;
+        size_t count = size_ + other.size_;
+        NodeBase* head = nullptr;
+        mergeChains(detachChain(), other.detachChain(), &head, comp);
+        attachChain(head);
+        size_ = count;
+        other.size_ = 0;
+    }
+
+    void merge(List<T, Alloc>& other) {
+        merge(other, std::less<T>());
+    }
+
+    void merge(List<T, Alloc>&& other) {
+        merge(other);
+    }
+
+    // stable bottom-up merge sort on nodes: no allocations, iterators stay valid
+    template <typename Compare>
+    void sort(Compare comp) {
+        if (size_ < 2) return;
+        NodeBase* head = detachChain();
+        for (size_t width = 1; width < size_; width *= 2) {
+            NodeBase* sorted = nullptr;
+            NodeBase** tail = &sorted;
+            while (head != nullptr) {
+                NodeBase* left = head;
+                NodeBase* right = cutChain(left, width);
+                head = cutChain(right, width);
+                tail = mergeChains(left, right, tail, comp);
+            }
+            head = sorted;
+        }
+        attachChain(head);
+    }
+
+    void sort() {
+        sort(std::less<T>());
+    }
+
     iterator begin() {
-        return iterator(buf_->next);
+        return iterator(sentinel_.next);
     }
 
     const_iterator begin() const {
@@ -258,11 +709,11 @@ public:
     }
 
     const_iterator cbegin() const {
-        return const_iterator(buf_->next);
+        return const_iterator(sentinel_.next);
     }
 
     iterator end() {
-        return iterator(buf_);
+        return iterator(&sentinel_);
     }
 
     const_iterator end() const {
@@ -270,7 +721,7 @@ public:
     }
 
     const_iterator cend() const {
-        return const_iterator(buf_);
+        return const_iterator(const_cast<NodeBase*>(&sentinel_));
     }
 
     reverse_iterator rbegin() {
@@ -0,0 +1,320 @@
+#include <list>
+#include <random>
+#include <vector>
+#include <iterator>
+#include <stdexcept>
+#include <unordered_map>
+#include <cassert>
+#include "fast_allocator.h"
+#include "list.h"
+
+// ordered by key only, seq tells apart equal keys so that stability is visible
+struct Item {
+    int key = 0;
+    int seq = 0;
+
+    bool operator<(const Item& other) const {
+        return key < other.key;
+    }
+
+    bool operator==(const Item& other) const {
+        return key == other.key && seq == other.seq;
+    }
+};
+
+template <typename Expected>
+void CheckSame(const List<Item>& list, const Expected& expected) {
+    assert(list.size() == expected.size());
+    assert(std::equal(list.begin(), list.end(), expected.begin(), expected.end()));
+    assert(std::equal(list.rbegin(), list.rend(), expected.rbegin(), expected.rend()));
+    assert(static_cast<size_t>(std::distance(list.begin(), list.end())) == list.size());
+}
+
+template <typename L>
+typename L::const_iterator At(const L& list, size_t pos) {
+    return std::next(list.begin(), pos);
+}
+
+// random splices within and between two lists, extract/insert of nodes, sort and merge,
+// everything mirrored on std::list
+void RandomTest(int ops, unsigned seed) {
+    std::mt19937 gen(seed);
+    List<Item> lists[2];
+    std::list<Item> expected[2];
+    int seq = 0;
+    auto randomItem = [&] {
+        return Item{static_cast<int>(gen() % 8), seq++};
+    };
+    for (int op = 0; op < ops; ++op) {
+        size_t a = gen() % 2;
+        size_t b = gen() % 2;
+        List<Item>& list = lists[a];
+        List<Item>& other = lists[b];
+        std::list<Item>& exp = expected[a];
+        std::list<Item>& otherExp = expected[b];
+        size_t kind = gen() % 12;
+        if (kind < 3 || otherExp.empty()) {
+            size_t pos = gen() % (exp.size() + 1);
+            Item item = randomItem();
+            list.insert(At(list, pos), item);
+            exp.insert(At(exp, pos), item);
+        } else if (kind == 3) {
+            size_t pos = gen() % otherExp.size();
+            other.erase(At(other, pos));
+            otherExp.erase(At(otherExp, pos));
+        } else if (kind == 4) {
+            // a single element, possibly moved inside the same list and possibly onto itself
+            size_t from = gen() % otherExp.size();
+            size_t pos = gen() % (exp.size() + 1);
+            list.splice(At(list, pos), other, At(other, from));
+            exp.splice(At(exp, pos), otherExp, At(otherExp, from));
+        } else if (kind < 7) {
+            // a range, pos is outside of it or at its start when both are in the same list
+            size_t first = gen() % (otherExp.size() + 1);
+            size_t last = first + gen() % (otherExp.size() - first + 1);
+            size_t pos = gen() % (exp.size() + 1);
+            if (a == b && pos > first && pos < last) {
+                pos = last;
+            }
+            list.splice(At(list, pos), other, At(other, first), At(other, last));
+            // pos == first is a no-op here but undefined for std::list
+            if (a != b || pos != first || first == last) {
+                exp.splice(At(exp, pos), otherExp, At(otherExp, first), At(otherExp, last));
+            }
+        } else if (kind == 7 && a != b) {
+            size_t pos = gen() % (exp.size() + 1);
+            list.splice(At(list, pos), other);
+            exp.splice(At(exp, pos), otherExp);
+            assert(other.empty());
+        } else if (kind == 8) {
+            size_t from = gen() % otherExp.size();
+            auto node = other.extract(At(other, from));
+            assert(!node.empty() && node.value() == *At(otherExp, from));
+            Item item = node.value();
+            otherExp.erase(At(otherExp, from));
+            if (gen() % 4 == 0) {
+                // dropped without being inserted again
+                continue;
+            }
+            size_t pos = gen() % (exp.size() + 1);
+            auto it = list.insert(At(list, pos), std::move(node));
+            assert(node.empty() && *it == item);
+            exp.insert(At(exp, pos), item);
+        } else if (kind == 9) {
+            // the nodes are relinked, so every element keeps its address
+            std::unordered_map<int, const Item*> address;
+            for (const Item& item : list) {
+                address[item.seq] = &item;
+            }
+            list.sort();
+            exp.sort();
+            for (const Item& item : list) {
+                assert(address.at(item.seq) == &item);
+            }
+        } else if (kind == 10 && a != b) {
+            list.sort();
+            exp.sort();
+            other.sort();
+            otherExp.sort();
+            list.merge(other);
+            exp.merge(otherExp);
+            assert(other.empty());
+        } else {
+            // descending, equal keys keep their order
+            auto greater = [](const Item& x, const Item& y) {
+                return y < x;
+            };
+            list.sort(greater);
+            exp.sort(greater);
+        }
+        CheckSame(lists[0], expected[0]);
+        CheckSame(lists[1], expected[1]);
+    }
+}
+
+// many equal keys: sort is stable and merge takes the elements of this list first
+void StabilityTest() {
+    std::mt19937 gen(7);
+    for (size_t n : {0, 1, 2, 3, 31, 64, 1000}) {
+        List<Item> list;
+        List<Item> other;
+        std::list<Item> exp;
+        std::list<Item> otherExp;
+        for (size_t i = 0; i < n; ++i) {
+            Item item{static_cast<int>(gen() % 3), static_cast<int>(i)};
+            list.push_back(item);
+            exp.push_back(item);
+            item.seq += n;
+            other.push_front(item);
+            otherExp.push_front(item);
+        }
+        list.sort();
+        exp.sort();
+        other.sort();
+        otherExp.sort();
+        CheckSame(list, exp);
+        CheckSame(other, otherExp);
+        for (auto it = list.begin(); it != list.end() && std::next(it) != list.end(); ++it) {
+            assert(it->key < std::next(it)->key || it->seq < std::next(it)->seq);
+        }
+        list.merge(other);
+        exp.merge(otherExp);
+        CheckSame(list, exp);
+        assert(other.empty() && other.begin() == other.end());
+    }
+}
+
+// copies throw once `throwAfter` more copies have been made, alive counts the objects
+struct Fragile {
+    static int alive;
+    static int throwAfter;
+
+    int x;
+
+    Fragile(int x): x(x) {
+        ++alive;
+    }
+    Fragile(const Fragile& other): x(other.x) {
+        if (throwAfter >= 0 && throwAfter-- == 0) {
+            throw std::runtime_error("copy failed");
+        }
+        ++alive;
+    }
+    Fragile& operator=(const Fragile&) = delete;
+    ~Fragile() {
+        --alive;
+    }
+};
+
+int Fragile::alive = 0;
+int Fragile::throwAfter = -1;
+
+// a single-pass iterator over ints whose increment throws after a given number of steps
+class FlakyInputIterator {
+private:
+    const int* current_ = nullptr;
+    int stepsLeft_ = -1;
+
+public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = int;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const int*;
+    using reference = const int&;
+
+    FlakyInputIterator() = default;
+    FlakyInputIterator(const int* current, int stepsLeft): current_(current), stepsLeft_(stepsLeft) {}
+
+    const int& operator*() const {
+        return *current_;
+    }
+
+    FlakyInputIterator& operator++() {
+        if (stepsLeft_ >= 0 && stepsLeft_-- == 0) {
+            throw std::runtime_error("increment failed");
+        }
+        ++current_;
+        return *this;
+    }
+
+    bool operator==(const FlakyInputIterator& other) const {
+        return current_ == other.current_;
+    }
+
+    bool operator!=(const FlakyInputIterator& other) const {
+        return current_ != other.current_;
+    }
+};
+
+// the list holds exactly `expected`, in the nodes it had before
+template <typename L>
+void CheckUnchanged(const L& list, const std::vector<int>& expected, const std::vector<const Fragile*>& addresses) {
+    assert(list.size() == expected.size());
+    size_t i = 0;
+    for (const Fragile& item : list) {
+        assert(item.x == expected[i] && &item == addresses[i]);
+        ++i;
+    }
+    assert(i == expected.size());
+}
+
+// every batched insertion either inserts everything or throws and leaves the list as it was,
+// whichever element constructor or iterator increment fails, including ones past the first batch
+template <typename Alloc>
+void StrongGuaranteeTest() {
+    using L = List<Fragile, Alloc>;
+    const int kSource = 150;
+    std::vector<Fragile> source;
+    std::vector<int> raw;
+    for (int i = 0; i < kSource; ++i) {
+        source.emplace_back(1000 + i);
+        raw.push_back(1000 + i);
+    }
+    const int alive = Fragile::alive;
+    {
+        L list;
+        std::vector<int> expected;
+        for (int i = 0; i < 5; ++i) {
+            list.emplace_back(i);
+            expected.push_back(i);
+        }
+        std::vector<const Fragile*> addresses;
+        for (const Fragile& item : list) {
+            addresses.push_back(&item);
+        }
+
+        auto expectThrow = [&](auto action) {
+            try {
+                action();
+                assert(false);
+            } catch (const std::runtime_error&) {
+            }
+            Fragile::throwAfter = -1;
+            CheckUnchanged(list, expected, addresses);
+            assert(Fragile::alive == alive + static_cast<int>(expected.size()));
+        };
+
+        for (int fail = 0; fail < kSource; fail += (fail < 70 ? 1 : 13)) {
+            auto middle = std::next(list.cbegin(), 2);
+            Fragile::throwAfter = fail;
+            expectThrow([&] { L copy(source.begin(), source.end()); });
+            Fragile::throwAfter = fail;
+            expectThrow([&] { list.insert(middle, source.begin(), source.end()); });
+            Fragile::throwAfter = fail;
+            expectThrow([&] { list.assign(source.begin(), source.end()); });
+            Fragile::throwAfter = fail;
+            expectThrow([&] { list.insert(middle, kSource, source[0]); });
+            Fragile::throwAfter = fail;
+            expectThrow([&] { list.assign(kSource, source[0]); });
+            Fragile::throwAfter = fail;
+            expectThrow([&] { L copy(kSource, source[0]); });
+
+            FlakyInputIterator first(raw.data(), fail);
+            FlakyInputIterator last(raw.data() + raw.size(), -1);
+            expectThrow([&] { L copy(first, last); });
+            expectThrow([&] { list.insert(middle, first, last); });
+            expectThrow([&] { list.assign(first, last); });
+        }
+
+        // and without failures everything goes in
+        list.insert(std::next(list.cbegin(), 2), FlakyInputIterator(raw.data(), -1),
+                    FlakyInputIterator(raw.data() + raw.size(), -1));
+        expected.insert(expected.begin() + 2, raw.begin(), raw.end());
+        assert(list.size() == expected.size());
+        assert(std::equal(list.begin(), list.end(), expected.begin(), [](const Fragile& a, int b) {
+            return a.x == b;
+        }));
+        list.assign(source.begin(), source.begin() + 3);
+        assert(list.size() == 3 && list.front().x == 1000 && list.back().x == 1002);
+    }
+    assert(Fragile::alive == alive);
+}
+
+int main() {
+    for (unsigned seed = 1; seed <= 20; ++seed) {
+        RandomTest(2000, seed);
+    }
+    StabilityTest();
+    StrongGuaranteeTest<std::allocator<Fragile>>();
+    StrongGuaranteeTest<FastAllocator<Fragile>>();
+}
@@ -0,0 +1,486 @@
+#pragma once
+
+#include <new>
+#include <memory>
+#include <iterator>
+#include <algorithm>
+
+// List that keeps up to NodeCapacity elements per node, so a traversal misses the cache
+// once per node instead of once per element. The API mirrors List.
+//
+// Iterator and reference stability:
+//  - push_back and insertion at end() never invalidate anything;
+//  - other insertions (push_front too) invalidate iterators and references to the node the element
+//    lands in; if that node was full, its first element moves to the end of the previous node when
+//    that one has room, otherwise the node is split and its upper half moves to a new node;
+//  - erase invalidates iterators and references to its node and to the next one, which may be merged in;
+//  - iterators and references to elements of other nodes, and end(), stay valid.
+//
+// Inserting in the middle moves the elements after the position within the node. Once the node is full,
+// an insertion hands an element to the previous node if it can and splits the node otherwise: a split
+// allocates a node and moves half of it, so insertions into densely filled nodes (e.g. after push_back)
+// cost up to an allocation of a whole node plus NodeCapacity / 2 moves. unrolled_list_bench does exactly
+// that with nodes of 8, and there the time goes into malloc, which is slow for node-sized blocks on a heap
+// littered with freed small ones; with FastAllocator the same insertions are faster than List's.
+template <typename T, typename Alloc = std::allocator<T>, size_t NodeCapacity = std::max<size_t>(8, 256 / sizeof(T))>
+class UnrolledList {
+    static_assert(NodeCapacity >= 2, "a node must hold at least two elements");
+
+    struct NodeBase {
+        NodeBase* prev = nullptr;
+        NodeBase* next = nullptr;
+        size_t count = 0;
+    };
+
+    struct Node: NodeBase {
+        alignas(T) unsigned char storage[NodeCapacity * sizeof(T)];
+
+        T* slot(size_t i) {
+            return std::launder(reinterpret_cast<T*>(storage + i * sizeof(T)));
+        }
+
+        bool full() const {
+            return this->count == NodeCapacity;
+        }
+    };
+
+    using Traits = std::allocator_traits<Alloc>;
+    using TraitsNode = typename std::allocator_traits<Alloc>::template rebind_traits<Node>;
+
+    Alloc alloc_;
+    typename std::allocator_traits<Alloc>::template rebind_alloc<Node> allocNode_;
+    NodeBase sentinel_; // stored inline, so it has to be relinked on swap
+    size_t size_ = 0;
+
+    static Node* asNode(NodeBase* base) {
+        return static_cast<Node*>(base);
+    }
+
+    void resetSentinel() {
+        sentinel_.prev = &sentinel_;
+        sentinel_.next = &sentinel_;
+    }
+
+    Node* newNodeAfter(NodeBase* pos) {
+        Node* node = TraitsNode::allocate(allocNode_, 1);
+        ::new (static_cast<void*>(node)) Node; // default-initialized, the storage is not zero-filled
+        node->prev = pos;
+        node->next = pos->next;
+        pos->next->prev = node;
+        pos->next = node;
+        return node;
+    }
+
+    void freeNode(Node* node) {
+        node->prev->next = node->next;
+        node->next->prev = node->prev;
+        node->~Node();
+        TraitsNode::deallocate(allocNode_, node, 1);
+    }
+
+    // moves one element into raw storage and ends the lifetime of the source
+    void relocate(T* from, T* to) {
+        Traits::construct(alloc_, to, std::move(*from));
+        Traits::destroy(alloc_, from);
+    }
+
+    // moves elements [from, src->count) to the end of dst
+    void moveTail(Node* src, size_t from, Node* dst) {
+        for (size_t i = from; i < src->count; ++i) {
+            relocate(src->slot(i), dst->slot(dst->count++));
+        }
+        src->count = from;
+    }
+
+    // slot idx is raw afterwards, count is not changed
+    void openGap(Node* node, size_t idx) {
+        for (size_t i = node->count; i > idx; --i) {
+            relocate(node->slot(i - 1), node->slot(i));
+        }
+    }
+
+    // slot idx is raw, elements after it are moved one to the left, count is not changed
+    void closeGap(Node* node, size_t idx, size_t end) {
+        for (size_t i = idx + 1; i < end; ++i) {
+            relocate(node->slot(i), node->slot(i - 1));
+        }
+    }
+
+    void destroyAll() {
+        NodeBase* it = sentinel_.next;
+        while (it != &sentinel_) {
+            Node* node = asNode(it);
+            it = it->next;
+            for (size_t i = 0; i < node->count; ++i) {
+                Traits::destroy(alloc_, node->slot(i));
+            }
+            node->~Node();
+            TraitsNode::deallocate(allocNode_, node, 1);
+        }
+        resetSentinel();
+        size_ = 0;
+    }
+
+    // takes the nodes of `that`, whose sentinel is reset
+    void adopt(NodeBase& that) {
+        if (that.next == &that) {
+            resetSentinel();
+            return;
+        }
+        sentinel_.next = that.next;
+        sentinel_.prev = that.prev;
+        sentinel_.next->prev = &sentinel_;
+        sentinel_.prev->next = &sentinel_;
+        that.next = &that;
+        that.prev = &that;
+    }
+
+public:
+    explicit UnrolledList(const Alloc& alloc = Alloc()): alloc_(alloc), allocNode_(alloc) {
+        resetSentinel();
+    }
+
+    UnrolledList(size_t n, const Alloc& alloc = Alloc()): UnrolledList(alloc) {
+        for (size_t i = 0; i < n; ++i) {
+            emplace(end());
+        }
+    }
+
+    UnrolledList(size_t n, const T& value, const Alloc& alloc = Alloc()): UnrolledList(alloc) {
+        for (size_t i = 0; i < n; ++i) {
+            push_back(value);
+        }
+    }
+
+    UnrolledList(const UnrolledList& list):
+            UnrolledList(Traits::select_on_container_copy_construction(list.alloc_)) {
+        for (auto& it : list) {
+            push_back(it);
+        }
+    }
+
+    UnrolledList(UnrolledList&& list) noexcept: alloc_(list.alloc_), allocNode_(list.allocNode_), size_(list.size_) {
+        adopt(list.sentinel_);
+        list.size_ = 0;
+    }
+
+    UnrolledList& operator=(const UnrolledList& list) {
+        if (this == &list) return *this;
+        UnrolledList copy(list);
+        swap(copy);
+        return *this;
+    }
+
+    // steals the nodes together with the allocator
+    UnrolledList& operator=(UnrolledList&& list) noexcept {
+        if (this == &list) return *this;
+        UnrolledList moved(std::move(list));
+        swap(moved);
+        return *this;
+    }
+
+    ~UnrolledList() {
+        destroyAll();
+    }
+
+    void swap(UnrolledList& that) noexcept {
+        if (this == &that) return;
+        using std::swap;
+        NodeBase mine;
+        mine.next = &mine;
+        mine.prev = &mine;
+        if (sentinel_.next != &sentinel_) {
+            mine.next = sentinel_.next;
+            mine.prev = sentinel_.prev;
+            mine.next->prev = &mine;
+            mine.prev->next = &mine;
+        }
+        adopt(that.sentinel_);
+        that.adopt(mine);
+        swap(alloc_, that.alloc_);
+        swap(allocNode_, that.allocNode_);
+        swap(size_, that.size_);
+    }
+
+    template <bool isConst>
+    class iterator_impl {
+    private:
+        NodeBase* node_ = nullptr;
+        size_t index_ = 0;
+
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = std::conditional_t<isConst, const T, T>;
+        using difference_type = std::ptrdiff_t;
+        using reference = value_type&;
+        using pointer = value_type*;
+
+        iterator_impl() = default;
+        iterator_impl(const iterator_impl<isConst>&) = default;
+        iterator_impl<isConst>& operator=(const iterator_impl<isConst>&) = default;
+
+        operator iterator_impl<true>() const {
+            return iterator_impl<true>(node_, index_);
+        }
+
+        iterator_impl<isConst>& operator++() {
+            if (++index_ == node_->count) {
+                node_ = node_->next;
+                index_ = 0;
+            }
+            return *this;
+        }
+
+        iterator_impl<isConst> operator++(int) {
+            auto ans = *this;
+            ++*this;
+            return ans;
+        }
+
+        iterator_impl<isConst>& operator--() {
+            if (index_ == 0) {
+                node_ = node_->prev;
+                index_ = node_->count;
+            }
+            --index_;
+            return *this;
+        }
+
+        iterator_impl<isConst> operator--(int) {
+            auto ans = *this;
+            --*this;
+            return ans;
+        }
+
+        reference operator*() const {
+            return *asNode(node_)->slot(index_);
+        }
+
+        pointer operator->() const {
+            return asNode(node_)->slot(index_);
+        }
+
+        friend bool operator==(const iterator_impl<isConst>& a, const iterator_impl<isConst>& b) {
+            return a.node_ == b.node_ && a.index_ == b.index_;
+        }
+
+        friend bool operator!=(const iterator_impl<isConst>& a, const iterator_impl<isConst>& b) {
+            return !(a == b);
+        }
+
+    protected:
+        iterator_impl(NodeBase* node, size_t index): node_(node), index_(index) {}
+
+        friend class UnrolledList<T, Alloc, NodeCapacity>;
+    };
+
+    using const_iterator = iterator_impl<true>;
+
+    using iterator = iterator_impl<false>;
+
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    using reverse_iterator = std::reverse_iterator<iterator>;
+
+    template <typename... Args>
+    iterator emplace(const_iterator pos, Args&&... args) {
+        NodeBase* base = pos.node_;
+        size_t idx = pos.index_;
+        Node* node = nullptr;
+        bool gapOpen = false;
+        if (idx == 0 && base->prev != &sentinel_ && !asNode(base->prev)->full()) {
+            // append to the previous node, the elements at pos stay where they are
+            node = asNode(base->prev);
+            idx = node->count;
+        } else if (base == &sentinel_ || (idx == 0 && asNode(base)->full())) {
+            node = newNodeAfter(base->prev);
+        } else {
+            node = asNode(base);
+            if (node->full() && node->prev != &sentinel_ && !asNode(node->prev)->full()) {
+                // no new node: the first element goes to the end of the previous node and the ones
+                // before idx shift left, which leaves slot idx - 1 raw, as openGap would
+                Node* prev = asNode(node->prev);
+                relocate(node->slot(0), prev->slot(prev->count++));
+                closeGap(node, 0, idx);
+                --node->count;
+                --idx;
+                gapOpen = true;
+            } else if (node->full()) {
+                Node* upper = newNodeAfter(node);
+                moveTail(node, NodeCapacity / 2, upper);
+                if (idx > node->count) {
+                    idx -= node->count;
+                    node = upper;
+                }
+            }
+        }
+        if (!gapOpen) openGap(node, idx);
+        try {
+            Traits::construct(alloc_, node->slot(idx), std::forward<Args>(args)...);
+        } catch (...) {
+            closeGap(node, idx, node->count + 1);
+            if (node->count == 0) freeNode(node);
+            throw;
+        }
+        ++node->count;
+        ++size_;
+        return iterator(node, idx);
+    }
+
+    iterator insert(const_iterator pos, const T& value) {
+        return emplace(pos, value);
+    }
+
+    iterator insert(const_iterator pos, T&& value) {
+        return emplace(pos, std::move(value));
+    }
+
+    iterator erase(const_iterator pos) {
+        if (pos.node_ == &sentinel_) return end();
+        Node* node = asNode(pos.node_);
+        size_t idx = pos.index_;
+        Traits::destroy(alloc_, node->slot(idx));
+        closeGap(node, idx, node->count);
+        --node->count;
+        --size_;
+        NodeBase* next = node->next;
+        if (node->count == 0) {
+            freeNode(node);
+            return iterator(next, 0);
+        }
+        // keep nodes dense: a node below a quarter full swallows its neighbour if it fits
+        if (node->count < NodeCapacity / 4 && next != &sentinel_ && node->count + next->count <= NodeCapacity) {
+            size_t count = node->count;
+            moveTail(asNode(next), 0, node);
+            freeNode(asNode(next));
+            if (idx == count) return iterator(node, idx);
+            next = node->next;
+        }
+        if (idx == node->count) return iterator(next, 0);
+        return iterator(node, idx);
+    }
+
+    iterator erase(const_iterator begin, const_iterator end) {
+        // erase() may merge the node `end` points into, so count first
+        size_t n = std::distance(begin, end);
+        iterator ans(begin.node_, begin.index_);
+        for (size_t i = 0; i < n; ++i) {
+            ans = erase(ans);
+        }
+        return ans;
+    }
+
+    template <typename... Args>
+    T& emplace_back(Args&&... args) {
+        return *emplace(end(), std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    T& emplace_front(Args&&... args) {
+        return *emplace(begin(), std::forward<Args>(args)...);
+    }
+
+    void push_front(const T& value) {
+        emplace(begin(), value);
+    }
+
+    void push_front(T&& value) {
+        emplace(begin(), std::move(value));
+    }
+
+    void push_back(const T& value) {
+        emplace(end(), value);
+    }
+
+    void push_back(T&& value) {
+        emplace(end(), std::move(value));
+    }
+
+    void pop_back() {
+        erase(--end());
+    }
+
+    void pop_front() {
+        erase(begin());
+    }
+
+    T& back() {
+        return *--end();
+    }
+
+    const T& back() const {
+        return *--end();
+    }
+
+    T& front() {
+        return *begin();
+    }
+
+    const T& front() const {
+        return *begin();
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    void clear() {
+        destroyAll();
+    }
+
+    Alloc get_allocator() {
+        return alloc_;
+    }
+
+    iterator begin() {
+        return iterator(sentinel_.next, 0);
+    }
+
+    const_iterator begin() const {
+        return cbegin();
+    }
+
+    const_iterator cbegin() const {
+        return const_iterator(sentinel_.next, 0);
+    }
+
+    iterator end() {
+        return iterator(&sentinel_, 0);
+    }
+
+    const_iterator end() const {
+        return cend();
+    }
+
+    const_iterator cend() const {
+        return const_iterator(const_cast<NodeBase*>(&sentinel_), 0);
+    }
+
+    reverse_iterator rbegin() {
+        return reverse_iterator(end());
+    }
+
+    const_reverse_iterator rbegin() const {
+        return crbegin();
+    }
+
+    const_reverse_iterator crbegin() const {
+        return const_reverse_iterator(cend());
+    }
+
+    reverse_iterator rend() {
+        return reverse_iterator(begin());
+    }
+
+    const_reverse_iterator rend() const {
+        return crend();
+    }
+
+    const_reverse_iterator crend() const {
+        return const_reverse_iterator(cbegin());
+    }
+};
@@ -0,0 +1,112 @@
+// UnrolledList against List: traversal, insertion and erasure.
+//
+//     g++ -std=c++17 -O2 unrolled_list_bench.cpp -o unrolled_list_bench
+//
+// Prints one tab-separated line per (operation, element size, container) with ns per element.
+// Lists are built with interleaved junk allocations so that List nodes are scattered in memory
+// the way they are in a long-running process.
+
+#include <random>
+#include <vector>
+#include <memory>
+#include <cstdio>
+#include <string>
+#include <iterator>
+#include <type_traits>
+
+#include "bench.h"
+#include "list.h"
+#include "unrolled_list.h"
+
+// iterator to the inserted element, List::insert returns nothing and keeps `pos` valid
+template <typename Container, typename Iterator, typename T>
+Iterator InsertBefore(Container& container, Iterator pos, const T& value) {
+    if constexpr (std::is_void_v<decltype(container.insert(pos, value))>) {
+        container.insert(pos, value);
+        return std::prev(pos);
+    } else {
+        return container.insert(pos, value);
+    }
+}
+
+template <typename Container>
+void Fill(Container& container, size_t count, std::vector<std::unique_ptr<char[]>>& junk) {
+    std::mt19937 gen(1);
+    for (size_t i = 0; i < count; ++i) {
+        container.push_back(typename Container::iterator::value_type());
+        container.back().data[0] = static_cast<long long>(i);
+        junk.emplace_back(new char[16 + gen() % 64]);
+    }
+}
+
+template <size_t Size, typename Container>
+void BenchContainer(const char* name, size_t count) {
+    std::vector<std::unique_ptr<char[]>> junk;
+    Container container;
+    {
+        Timer timer;
+        Fill(container, count, junk);
+        Report("push_back", Size, name, timer.nsPer(count));
+    }
+    junk.clear();
+
+    long long sum = 0;
+    const int kPasses = 10;
+    {
+        Timer timer;
+        for (int pass = 0; pass < kPasses; ++pass) {
+            for (auto& it : container) {
+                sum += it.data[0];
+            }
+        }
+        Report("traverse", Size, name, timer.nsPer(count * kPasses));
+    }
+
+    // one element after every eighth one
+    {
+        Timer timer;
+        size_t inserted = 0;
+        size_t i = 0;
+        for (auto it = container.begin(); it != container.end(); ++i) {
+            if (i % 8 == 7) {
+                it = InsertBefore(container, it, typename Container::iterator::value_type());
+                ++inserted;
+                ++it;
+            }
+            ++it;
+        }
+        Report("insert", Size, name, timer.nsPer(inserted));
+    }
+
+    {
+        Timer timer;
+        size_t erased = 0;
+        size_t i = 0;
+        for (auto it = container.begin(); it != container.end(); ++i) {
+            if (i % 2 == 0) {
+                it = container.erase(it);
+                ++erased;
+            } else {
+                ++it;
+            }
+        }
+        Report("erase", Size, name, timer.nsPer(erased));
+    }
+
+    if (sum == 42) std::printf("\n");
+}
+
+template <size_t Size>
+void BenchSize(size_t count) {
+    using T = Object<Size>;
+    BenchContainer<Size, List<T>>("List", count);
+    BenchContainer<Size, UnrolledList<T>>("UnrolledList", count);
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::stoul(argv[1]) : 1'000'000;
+    std::printf("operation\tsize\tcontainer\tns/element\n");
+    BenchSize<8>(count);
+    BenchSize<32>(count);
+    BenchSize<128>(count / 4);
+}
@@ -0,0 +1,192 @@
+#include <list>
+#include <random>
+#include <string>
+#include <vector>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <cassert>
+#include "unrolled_list.h"
+
+// counts live objects, and throws from its constructor once `throwAfter` more constructions have happened
+struct Tracked {
+    static int alive;
+    static int throwAfter;
+
+    int value = 0;
+
+    explicit Tracked(int value): value(value) {
+        countdown();
+        ++alive;
+    }
+    Tracked(const Tracked& other): value(other.value) {
+        countdown();
+        ++alive;
+    }
+    Tracked(Tracked&& other) noexcept: value(other.value) {
+        ++alive;
+    }
+    Tracked& operator=(const Tracked&) = default;
+    ~Tracked() {
+        --alive;
+    }
+
+    static void countdown() {
+        if (throwAfter >= 0 && throwAfter-- == 0) {
+            throw std::runtime_error("construction failed");
+        }
+    }
+
+    bool operator==(const Tracked& other) const {
+        return value == other.value;
+    }
+};
+
+int Tracked::alive = 0;
+int Tracked::throwAfter = -1;
+
+static_assert(std::is_nothrow_move_constructible_v<UnrolledList<int>>);
+static_assert(std::is_nothrow_move_assignable_v<UnrolledList<int>>);
+
+template <typename Unrolled, typename Expected>
+void CheckSame(const Unrolled& list, const Expected& expected) {
+    assert(list.size() == expected.size());
+    assert(std::equal(list.begin(), list.end(), expected.begin(), expected.end()));
+    assert(std::equal(list.rbegin(), list.rend(), expected.rbegin(), expected.rend()));
+    if (!expected.empty()) {
+        assert(list.front() == expected.front());
+        assert(list.back() == expected.back());
+    }
+}
+
+// random insertions and erasures anywhere, including inside full nodes, checked against std::list
+template <size_t NodeCapacity>
+void RandomTest(int ops, unsigned seed) {
+    using Unrolled = UnrolledList<Tracked, std::allocator<Tracked>, NodeCapacity>;
+    std::mt19937 gen(seed);
+    {
+        Unrolled list;
+        std::list<Tracked> expected;
+        for (int op = 0; op < ops; ++op) {
+            int value = static_cast<int>(gen() % 1000);
+            size_t kind = gen() % 10;
+            if (kind < 5 || expected.empty()) {
+                size_t pos = gen() % (expected.size() + 1);
+                auto it = list.emplace(std::next(list.cbegin(), pos), value);
+                assert(it->value == value);
+                assert(std::distance(list.begin(), it) == static_cast<std::ptrdiff_t>(pos));
+                expected.emplace(std::next(expected.cbegin(), pos), value);
+            } else if (kind < 8) {
+                size_t pos = gen() % expected.size();
+                auto it = list.erase(std::next(list.cbegin(), pos));
+                assert(std::distance(list.begin(), it) == static_cast<std::ptrdiff_t>(pos));
+                expected.erase(std::next(expected.cbegin(), pos));
+            } else if (kind == 8) {
+                size_t from = gen() % expected.size();
+                size_t to = from + gen() % std::min<size_t>(expected.size() - from + 1, 3 * NodeCapacity);
+                list.erase(std::next(list.cbegin(), from), std::next(list.cbegin(), to));
+                expected.erase(std::next(expected.cbegin(), from), std::next(expected.cbegin(), to));
+            } else if (gen() % 2) {
+                list.push_front(Tracked(value));
+                expected.push_front(Tracked(value));
+            } else {
+                list.pop_back();
+                expected.pop_back();
+            }
+            if (op % 64 == 0) {
+                CheckSame(list, expected);
+            }
+        }
+        CheckSame(list, expected);
+
+        Unrolled copy = list;
+        CheckSame(copy, expected);
+        Unrolled moved = std::move(copy);
+        CheckSame(moved, expected);
+        assert(copy.empty());
+        copy = moved;
+        moved = std::move(list);
+        CheckSame(copy, expected);
+        CheckSame(moved, expected);
+        list.swap(moved);
+        CheckSame(list, expected);
+        assert(moved.empty());
+        list.clear();
+        assert(list.empty() && list.begin() == list.end());
+        assert(Tracked::alive == static_cast<int>(expected.size() + copy.size()));
+    }
+    assert(Tracked::alive == 0);
+}
+
+// a throwing constructor leaves the list as it was, whether the insertion was about to split a node,
+// hand an element to the previous one or just shift
+void ThrowingInsertTest() {
+    using Unrolled = UnrolledList<Tracked, std::allocator<Tracked>, 4>;
+    {
+        Unrolled list;
+        std::vector<int> expected;
+        for (int i = 0; i < 40; ++i) {
+            list.emplace_back(i);
+            expected.push_back(i);
+        }
+        // make some nodes have room so that every kind of insertion happens
+        for (int i = 0; i < 6; ++i) {
+            list.erase(std::next(list.begin(), 3 * i + 1));
+            expected.erase(expected.begin() + 3 * i + 1);
+        }
+        // each round inserts one element, so positions up to the original end cover every node
+        const size_t initialSize = expected.size();
+        for (size_t pos = 0; pos <= initialSize; ++pos) {
+            Tracked::throwAfter = 0;
+            try {
+                list.emplace(std::next(list.cbegin(), pos), -1);
+                assert(false);
+            } catch (const std::runtime_error&) {
+            }
+            Tracked::throwAfter = -1;
+            assert(list.size() == expected.size());
+            size_t i = 0;
+            for (const auto& item : list) {
+                assert(item.value == expected[i++]);
+            }
+            assert(Tracked::alive == static_cast<int>(expected.size()));
+
+            list.emplace(std::next(list.cbegin(), pos), -static_cast<int>(pos));
+            expected.insert(expected.begin() + pos, -static_cast<int>(pos));
+        }
+
+        Tracked::throwAfter = 10;
+        try {
+            Unrolled copy = list;
+            assert(false);
+        } catch (const std::runtime_error&) {
+        }
+        Tracked::throwAfter = -1;
+        assert(Tracked::alive == static_cast<int>(expected.size()));
+    }
+    assert(Tracked::alive == 0);
+}
+
+void TestStrings() {
+    UnrolledList<std::string> list(3, std::string(40, 'x'));
+    list.push_front("front");
+    list.insert(std::next(list.begin(), 2), std::string(100, 'y'));
+    list.emplace_back(5, 'z');
+    std::list<std::string> expected(3, std::string(40, 'x'));
+    expected.push_front("front");
+    expected.insert(std::next(expected.begin(), 2), std::string(100, 'y'));
+    expected.emplace_back(5, 'z');
+    CheckSame(list, expected);
+
+    UnrolledList<int> numbers(1000);
+    assert(numbers.size() == 1000 && numbers.front() == 0 && numbers.back() == 0);
+}
+
+int main() {
+    RandomTest<2>(3000, 1);
+    RandomTest<4>(5000, 2);
+    RandomTest<16>(5000, 3);
+    RandomTest<64>(20000, 4);
+    ThrowingInsertTest();
+    TestStrings();
+}
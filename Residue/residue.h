@@ -2,6 +2,11 @@
 #define RESIDUE_H
 
 #include <vector>
+#include <random>
+#include <algorithm>
+#include <unordered_map>
+#include <stdexcept>
+#include <iostream>
 
 using ull = unsigned long long;
 
@@ -13,6 +18,70 @@ struct static_assert_f<true> {
     static const bool value = true;
 };
 
+constexpr ull mulMod(ull a, ull b, ull mod) {
+#ifdef __SIZEOF_INT128__
+    return static_cast<unsigned __int128>(a) * b % mod;
+#else
+    // double-and-add that stays within [0, mod), so nothing overflows
+    ull ans = 0;
+    a %= mod;
+    b %= mod;
+    while (b) {
+        if (b & 1) ans = ans >= mod - a ? ans - (mod - a) : ans + a;
+        a = a >= mod - a ? a - (mod - a) : a + a;
+        b /= 2;
+    }
+    return ans;
+#endif
+}
+
+constexpr ull powMod(ull a, ull p, ull mod) {
+    ull ans = 1 % mod;
+    a %= mod;
+    while (p) {
+        if (p & 1) ans = mulMod(ans, a, mod);
+        p /= 2;
+        a = mulMod(a, a, mod);
+    }
+    return ans;
+}
+
+// deterministic Miller-Rabin, these bases are enough for any 64-bit n; constexpr so that
+// is_prime can check moduli like 1e9 + 7 without recursing once per candidate divisor
+constexpr bool isPrime(ull n) {
+    const ull bases[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+    if (n < 2) return false;
+    for (ull p : bases) {
+        if (n % p == 0) return n == p;
+    }
+    ull d = n - 1;
+    unsigned s = 0;
+    while (d % 2 == 0) {
+        d /= 2;
+        ++s;
+    }
+    for (ull a : bases) {
+        ull x = powMod(a, d, n);
+        if (x == 1 || x == n - 1) continue;
+        bool composite = true;
+        for (unsigned i = 1; i < s && composite; ++i) {
+            x = mulMod(x, x, n);
+            if (x == n - 1) composite = false;
+        }
+        if (composite) return false;
+    }
+    return true;
+}
+
+// smallest divisor of n other than 1, n itself if n is prime
+constexpr ull smallestDivisor(ull n) {
+    if (n % 2 == 0) return 2;
+    for (ull d = 3; d * d <= n; d += 2) {
+        if (n % d == 0) return d;
+    }
+    return n;
+}
+
 template <ull a, ull b>
 struct mid {
     static const ull value = (a + b) / 2u;
@@ -79,6 +148,8 @@ struct to_odd {
 template <ull N>
 const ull to_odd_v = to_odd<N>::value;
 
+#ifdef STRICT_NO_STL
+
 template <ull N, ull K = to_odd_v<ct_sqrt_v<N>>>
 struct less_divisor {
     static const ull value = min_v<N % K == 0 ? K : N, less_divisor<N, K - 2>::value>;
@@ -89,6 +160,15 @@ struct less_divisor<N, 1> {
     static const ull value = N % 2 == 0 ? 2 : N;
 };
 
+#else
+
+template <ull N>
+struct less_divisor {
+    static const ull value = smallestDivisor(N);
+};
+
+#endif
+
 template <ull N>
 const ull less_divisor_v = less_divisor<N>::value;
 
@@ -118,7 +198,7 @@ struct is_prime {
 
 template <ull N>
 struct is_prime {
-    static const bool value = less_divisor_v<N> == N;
+    static const bool value = isPrime(N);
 };
 
 #endif
@@ -212,6 +292,9 @@ template <unsigned N>
 class Residue {
     ull value;
 
+    // x in [0, ord) such that g^x == h, or ord if there is no such x
+    static ull babyStepGiantStep(Residue<N> g, Residue<N> h, ull ord);
+
 public:
     Residue(): value(0) {}
 
@@ -284,6 +367,12 @@ public:
 
     static Residue<N> getPrimitiveRoot();
 
+    // smallest x such that base^x == *this, Pohlig-Hellman over base.order()
+    ull log(const Residue<N>& base) const;
+
+    // the smaller of two square roots, N must be prime
+    Residue<N> sqrt() const;
+
     Residue<N>& operator++() {
         value += 1;
         if (value >= N) value -= N;
@@ -295,22 +384,103 @@ public:
     }
 };
 
-std::vector<ull> divisors(ull n) {
+// a must be coprime with mod
+inline ull inverseMod(ull a, ull mod) {
+    long long r0 = mod, r1 = a % mod;
+    long long s0 = 0, s1 = 1;
+    while (r1) {
+        long long q = r0 / r1;
+        r0 -= q * r1;
+        std::swap(r0, r1);
+        s0 -= q * s1;
+        std::swap(s0, s1);
+    }
+    if (s0 < 0) s0 += mod;
+    return s0 % mod;
+}
+
+// Pollard-Brent, n must be odd and composite
+inline ull pollardRho(ull n) {
+    // one generator per thread, so factorizing from several threads does not race
+    thread_local std::mt19937_64 gen(0x5eed);
+    auto absDiff = [](ull a, ull b) { return a > b ? a - b : b - a; };
+    const ull batch = 128;
+    while (true) {
+        ull c = gen() % (n - 1) + 1;
+        auto f = [n, c](ull v) {
+            ull res = mulMod(v, v, n) + c;
+            if (res >= n || res < c) res -= n;
+            return res;
+        };
+        ull y = gen() % n;
+        ull x = y;
+        ull ys = y;
+        ull q = 1;
+        ull g = 1;
+        for (ull r = 1; g == 1; r *= 2) {
+            x = y;
+            for (ull i = 0; i < r; ++i) y = f(y);
+            for (ull k = 0; k < r && g == 1; k += batch) {
+                ys = y;
+                for (ull i = 0; i < std::min(batch, r - k); ++i) {
+                    y = f(y);
+                    q = mulMod(q, absDiff(x, y), n);
+                }
+                g = gcd<ull>(q, n);
+            }
+        }
+        if (g == n) {
+            // the batch overshot, replay it one step at a time
+            do {
+                ys = f(ys);
+                g = gcd<ull>(absDiff(x, ys), n);
+            } while (g == 1);
+        }
+        if (g != n) return g;
+    }
+}
+
+inline void factorizeTo(ull n, std::vector<ull>& ans) {
+    if (n == 1) return;
+    if (isPrime(n)) {
+        ans.push_back(n);
+        return;
+    }
+    ull d = pollardRho(n);
+    factorizeTo(d, ans);
+    factorizeTo(n / d, ans);
+}
+
+// prime factors of n with multiplicity in ascending order
+inline std::vector<ull> factorize(ull n) {
     std::vector<ull> ans;
-    ans.push_back(1);
-    for (ull d = 2; d * d <= n; ++d) {
-        if (n % d == 0) {
-            n /= d;
-            ans.push_back(d);
+    for (ull p = 2; p < 64 && p * p <= n; ++p) {
+        while (n % p == 0) {
+            n /= p;
+            ans.push_back(p);
         }
     }
-    if (n != 1) ans.push_back(n);
+    factorizeTo(n, ans);
+    std::sort(ans.begin(), ans.end());
+    return ans;
+}
+
+// 1 followed by prime factors of n with multiplicity
+inline std::vector<ull> divisors(ull n) {
+    std::vector<ull> ans = factorize(n);
+    ans.insert(ans.begin(), 1);
+    return ans;
+}
+
+inline std::vector<ull> primeDivisors(ull n) {
+    std::vector<ull> ans = factorize(n);
+    ans.erase(std::unique(ans.begin(), ans.end()), ans.end());
     return ans;
 }
 
-unsigned phi(ull n) {
+inline ull phi(ull n) {
     std::vector<ull> d = divisors(n);
-    if (d.size() == 1) return 0;
+    if (d.size() == 1) return 1;
     ull ans = 1;
     for (size_t i = 1; i < d.size(); ++i) {
         if (d[i] == d[i - 1]) {
@@ -322,13 +492,34 @@ unsigned phi(ull n) {
     return ans;
 }
 
+// runtime counterpart of Residue<N>::getPrimitiveRoot for 64-bit moduli, 0 if there is none
+inline ull primitiveRoot(ull n) {
+    if (n <= 4) return n == 1 ? 0 : n - 1;
+    std::vector<ull> nd = primeDivisors(n);
+    bool hasRoot = (nd.size() == 1 && nd[0] != 2) || (nd.size() == 2 && nd[0] == 2 && n % 4 != 0);
+    if (!hasRoot) return 0;
+    ull p = phi(n);
+    std::vector<ull> div = primeDivisors(p);
+    for (ull g = 2; g < n; ++g) {
+        if (gcd<ull>(g, n) != 1) continue;
+        bool root = true;
+        for (ull d : div) {
+            if (powMod(g, p / d, n) == 1) {
+                root = false;
+                break;
+            }
+        }
+        if (root) return g;
+    }
+    return 0;
+}
+
 template <unsigned N>
 bool isPrimitiveRoot(Residue<N> v) {
     ull p = phi(N);
     if (v.pow(p) != 1) return false;
-    auto div = divisors(p);
+    auto div = primeDivisors(p);
     for (auto& d : div) {
-        if (d == 1) continue;
         if (v.pow(p / d) == 1) return false;
     }
     return true;
@@ -346,12 +537,12 @@ Residue<N> Residue<N>::getPrimitiveRoot() {
 }
 
 template <>
-Residue<2> Residue<2>::getPrimitiveRoot() {
+inline Residue<2> Residue<2>::getPrimitiveRoot() {
     return Residue<2>(1);
 }
 
 template <>
-Residue<4> Residue<4>::getPrimitiveRoot() {
+inline Residue<4> Residue<4>::getPrimitiveRoot() {
     return Residue<4>(3);
 }
 
@@ -360,10 +551,9 @@ ull Residue<N>::order() const {
     if (gcd<ull>(value, N) != 1) return 0;
     ull p = phi(N);
     ull ans = p;
-    for (ull d = 2; d * d <= 2 * ans; ++d) {
-        while (ans % d == 0) {
-            if (pow(ans / d) == 1) ans /= d;
-            else break;
+    for (ull d : primeDivisors(p)) {
+        while (ans % d == 0 && pow(ans / d) == 1) {
+            ans /= d;
         }
     }
     return ans;
@@ -374,6 +564,94 @@ Residue<N> Residue<N>::reOrder() const {
     return Residue<N>(order());
 }
 
+template <unsigned N>
+ull Residue<N>::babyStepGiantStep(Residue<N> g, Residue<N> h, ull ord) {
+    ull m = 1;
+    while (m * m < ord) ++m;
+    std::unordered_map<ull, ull> baby;
+    baby.reserve(m);
+    Residue<N> cur(1);
+    for (ull j = 0; j < m; ++j) {
+        baby.emplace(cur.value, j);
+        cur *= g;
+    }
+    Residue<N> giant = g.pow((ord - m % ord) % ord);
+    for (ull i = 0; i <= m; ++i) {
+        auto it = baby.find(h.value);
+        if (it != baby.end() && i * m + it->second < ord) {
+            return i * m + it->second;
+        }
+        h *= giant;
+    }
+    return ord;
+}
+
+template <unsigned N>
+ull Residue<N>::log(const Residue<N>& base) const {
+    ull m = base.order();
+    if (m == 0) throw std::domain_error("base is not invertible");
+    ull ans = 0;
+    ull mod = 1;
+    for (ull p : primeDivisors(m)) {
+        ull pe = 1;
+        ull e = 0;
+        while (m % (pe * p) == 0) {
+            pe *= p;
+            ++e;
+        }
+        Residue<N> g = base.pow(m / pe);
+        Residue<N> h = pow(m / pe);
+        Residue<N> gamma = g.pow(pe / p);
+        // x mod p^e digit by digit, each digit is a log in the subgroup of order p
+        ull x = 0;
+        ull pk = 1;
+        for (ull k = 0; k < e; ++k) {
+            Residue<N> hk = (g.pow(pe - x) * h).pow(pe / p / pk);
+            ull d = babyStepGiantStep(gamma, hk, p);
+            if (d == p) throw std::domain_error("logarithm does not exist");
+            x += d * pk;
+            pk *= p;
+        }
+        // CRT: ans mod `mod` and x mod pe into ans mod (mod * pe)
+        ull t = (x + pe - ans % pe) % pe * inverseMod(mod % pe, pe) % pe;
+        ans += mod * t;
+        mod *= pe;
+    }
+    if (base.pow(ans) != *this) throw std::domain_error("logarithm does not exist");
+    return ans;
+}
+
+template <unsigned N>
+Residue<N> Residue<N>::sqrt() const {
+    static_assert_f<is_prime_v<N>>();
+    if (value == 0 || N == 2) return *this;
+    if (pow((N - 1) / 2) != 1) throw std::domain_error("not a quadratic residue");
+    // Tonelli-Shanks
+    ull q = N - 1;
+    ull s = 0;
+    while (q % 2 == 0) {
+        q /= 2;
+        ++s;
+    }
+    Residue<N> z(2);
+    while (z.pow((N - 1) / 2) == 1) ++z;
+    Residue<N> c = z.pow(q);
+    Residue<N> t = pow(q);
+    Residue<N> r = pow((q + 1) / 2);
+    while (t != 1) {
+        ull i = 0;
+        for (Residue<N> tt = t; tt != 1; tt *= tt) ++i;
+        Residue<N> b = c;
+        for (ull j = 0; j + 1 < s - i; ++j) b *= b;
+        s = i;
+        c = b * b;
+        t *= c;
+        r *= b;
+    }
+    if (N - r.value < r.value) r.value = N - r.value;
+    return r;
+}
+
 template <unsigned N>
 Residue<N> operator+(const Residue<N>& a, const Residue<N>& b) {
     Residue<N> ans = a;
@@ -441,4 +719,76 @@ std::istream& operator>>(std::istream& in, Residue<N>& v) {
     return in;
 }
 
+template <unsigned N>
+class CombinatoricsTable {
+    std::vector<Residue<N>> fact_;
+    std::vector<Residue<N>> invFact_;
+
+    // binomial for n < N, table must already cover n
+    Residue<N> smallBinomial(ull n, ull k) const {
+        if (k > n) return Residue<N>(0);
+        return fact_[n] * invFact_[k] * invFact_[n - k];
+    }
+
+public:
+    explicit CombinatoricsTable(ull bound = 0) {
+        static_assert_f<is_prime_v<N>>();
+        reserve(bound);
+    }
+
+    // makes factorials of [0, bound] available; bound is capped by N - 1
+    // since n! = 0 for n >= N. The tables at least double when they grow,
+    // so growing one n at a time costs an inverse only O(log n) times
+    void reserve(ull bound) {
+        if (bound >= N) bound = N - 1;
+        size_t from = fact_.size();
+        if (bound < from) return;
+        bound = std::min<ull>(N - 1, std::max<ull>(bound, 2 * from));
+        fact_.resize(bound + 1);
+        invFact_.resize(bound + 1);
+        for (size_t i = from; i <= bound; ++i) {
+            fact_[i] = (i == 0 ? Residue<N>(1) : fact_[i - 1] * Residue<N>(i));
+        }
+        invFact_[bound] = fact_[bound].getInverse();
+        for (size_t i = bound; i > from; --i) {
+            invFact_[i - 1] = invFact_[i] * Residue<N>(i);
+        }
+    }
+
+    size_t size() const {
+        return fact_.size();
+    }
+
+    Residue<N> factorial(ull n) {
+        if (n >= N) return Residue<N>(0);
+        reserve(n);
+        return fact_[n];
+    }
+
+    Residue<N> inverseFactorial(ull n) {
+        if (n >= N) throw std::domain_error("n! is not invertible modulo N");
+        reserve(n);
+        return invFact_[n];
+    }
+
+    // Lucas' theorem is used for n >= N
+    Residue<N> binomial(ull n, ull k) {
+        if (k > n) return Residue<N>(0);
+        if (n < N) {
+            reserve(n);
+            return smallBinomial(n, k);
+        }
+        Residue<N> ans(1);
+        while (n > 0 && ans != 0) {
+            ull nd = n % N;
+            ull kd = k % N;
+            reserve(nd);
+            ans *= smallBinomial(nd, kd);
+            n /= N;
+            k /= N;
+        }
+        return ans;
+    }
+};
+
 #endif
@@ -0,0 +1,243 @@
+#include <vector>
+#include <cassert>
+#include "residue.h"
+
+// Pascal's triangle modulo N, built by additions only so it is right for n >= N as well
+template <unsigned N>
+std::vector<std::vector<unsigned>> PascalTable(size_t rows) {
+    std::vector<std::vector<unsigned>> pascal(rows);
+    for (size_t n = 0; n < rows; ++n) {
+        pascal[n].assign(n + 1, 1);
+        for (size_t k = 1; k < n; ++k) {
+            pascal[n][k] = (pascal[n - 1][k - 1] + pascal[n - 1][k]) % N;
+        }
+    }
+    return pascal;
+}
+
+template <unsigned N>
+void TestBinomial(size_t rows) {
+    auto pascal = PascalTable<N>(rows);
+    CombinatoricsTable<N> table;
+    for (size_t n = 0; n < rows; ++n) {
+        for (size_t k = 0; k <= n + 1; ++k) {
+            long long expected = k <= n ? pascal[n][k] : 0;
+            assert(table.binomial(n, k) == Residue<N>(expected));
+        }
+    }
+}
+
+// the moduli the table is meant for have to compile and take the Lucas path past N
+template <unsigned N>
+void TestLargeModulus() {
+    CombinatoricsTable<N> table(1000);
+    assert(table.size() == 1001);
+    for (ull n = 0; n <= 1000; ++n) {
+        assert(table.factorial(n) * table.inverseFactorial(n) == 1);
+    }
+    assert(table.factorial(N) == 0);
+    assert(table.binomial(N, 1) == 0);
+    assert(table.binomial(2ull * N, N) == 2);
+    assert(table.binomial(3ull * N + 5, N + 2) == Residue<N>(3 * 10));
+    assert(table.size() == 1001);
+}
+
+// smallest prime factor of every n < bound
+std::vector<ull> SmallestFactors(ull bound) {
+    std::vector<ull> spf(bound, 0);
+    for (ull i = 2; i < bound; ++i) {
+        if (spf[i] != 0) continue;
+        for (ull j = i; j < bound; j += i) {
+            if (spf[j] == 0) spf[j] = i;
+        }
+    }
+    return spf;
+}
+
+void TestFactorize(ull bound) {
+    auto spf = SmallestFactors(bound);
+    for (ull n = 2; n < bound; ++n) {
+        std::vector<ull> factors;
+        ull expectedPhi = 1;
+        for (ull m = n; m != 1; m /= spf[m]) {
+            ull p = spf[m];
+            expectedPhi *= factors.empty() || factors.back() != p ? p - 1 : p;
+            factors.push_back(p);
+        }
+        assert(factorize(n) == factors);
+        assert(isPrime(n) == (factors.size() == 1));
+        // the rest are built on factorize, a smaller range is enough for them
+        if (n >= bound / 10) continue;
+        assert(phi(n) == expectedPhi);
+
+        std::vector<ull> withOne = factors;
+        withOne.insert(withOne.begin(), 1);
+        assert(divisors(n) == withOne);
+        factors.erase(std::unique(factors.begin(), factors.end()), factors.end());
+        assert(primeDivisors(n) == factors);
+    }
+    assert(phi(1) == 1);
+    assert(factorize(1).empty());
+    assert(!isPrime(0) && !isPrime(1));
+}
+
+void TestFactorizeLarge() {
+    const ull p32 = 4294967291ull;
+    const ull q32 = 4294967279ull;
+    const ull p61 = (1ull << 61) - 1;
+    assert(isPrime(p32) && isPrime(q32) && isPrime(p61) && isPrime(1000000007));
+    assert(factorize(p61) == std::vector<ull>{p61});
+    assert(phi(p61) == p61 - 1);
+
+    assert(!isPrime(p32 * q32));
+    assert(factorize(p32 * q32) == (std::vector<ull>{q32, p32}));
+    assert(phi(p32 * q32) == (p32 - 1) * (q32 - 1));
+    assert(factorize(998244353ull * 1000000007) == (std::vector<ull>{998244353, 1000000007}));
+    assert(factorize(1000000007ull * 1000000007) == (std::vector<ull>{1000000007, 1000000007}));
+
+    // Carmichael numbers, the last one is a strong pseudoprime to every prime base below 37
+    const std::vector<std::vector<ull>> carmichael = {
+        {3, 11, 17},
+        {7, 13, 19},
+        {5, 29, 73},
+        {6763, 10627, 29947},
+        {149491, 747451, 34233211},
+    };
+    for (const auto& factors : carmichael) {
+        ull n = factors[0] * factors[1] * factors[2];
+        assert(!isPrime(n));
+        assert(factorize(n) == factors);
+        assert(primeDivisors(n) == factors);
+        assert(phi(n) == (factors[0] - 1) * (factors[1] - 1) * (factors[2] - 1));
+    }
+
+    ull powers = 1;
+    std::vector<ull> factors;
+    for (int i = 0; i < 20; ++i) {
+        powers *= 7;
+        factors.push_back(7);
+    }
+    assert(factorize(powers) == factors);
+    assert(factorize(1ull << 63) == std::vector<ull>(63, 2));
+}
+
+// compares with the smallest g whose powers run through all units modulo n
+void TestPrimitiveRoot(ull bound) {
+    for (ull n = 2; n < bound; ++n) {
+        ull units = phi(n);
+        ull expected = 0;
+        for (ull g = 1; g < n && expected == 0; ++g) {
+            if (gcd<ull>(g, n) != 1) continue;
+            ull order = 1;
+            for (ull x = g % n; x != 1 % n; x = x * g % n) {
+                ++order;
+            }
+            if (order == units) expected = g;
+        }
+        assert(primitiveRoot(n) == expected);
+    }
+    assert(primitiveRoot(1000000007) == 5);
+    assert(primitiveRoot(998244353) == 3);
+    assert(primitiveRoot(2 * 1000000007ull) == 5);
+}
+
+void TestMulMod() {
+    const ull mod = (1ull << 63) + 29;
+    assert(mulMod(mod - 1, mod - 1, mod) == 1);
+    assert(mulMod(mod - 1, 2, mod) == mod - 2);
+    assert(mulMod(~0ull, ~0ull, 1000000007) == (~0ull % 1000000007) * (~0ull % 1000000007) % 1000000007);
+    assert(powMod(3, 1000000006, 1000000007) == 1);
+    static_assert(isPrime(998244353) && !isPrime(561), "isPrime has to work at compile time");
+}
+
+// log against the smallest exponent found by brute force, sqrt against the smaller root
+template <unsigned N>
+void TestLogAndSqrt() {
+    for (unsigned b = 0; b < N; ++b) {
+        Residue<N> base(b);
+        for (unsigned v = 0; v < N; ++v) {
+            Residue<N> x(v);
+            ull expected = N;
+            Residue<N> power(1);
+            for (ull e = 0; e < N && gcd<ull>(b, N) == 1; ++e, power *= base) {
+                if (power == x) {
+                    expected = e;
+                    break;
+                }
+            }
+            try {
+                ull e = x.log(base);
+                assert(e == expected);
+                assert(base.pow(e) == x);
+            } catch (const std::domain_error&) {
+                assert(expected == N);
+            }
+        }
+    }
+
+    if constexpr (is_prime_v<N>) {
+        for (unsigned v = 0; v < N; ++v) {
+            Residue<N> x(v);
+            unsigned expected = N;
+            for (unsigned r = 0; r < N && expected == N; ++r) {
+                if (Residue<N>(r) * Residue<N>(r) == x) expected = r;
+            }
+            try {
+                Residue<N> root = x.sqrt();
+                assert(static_cast<int>(root) == static_cast<int>(expected));
+                assert(root * root == x);
+            } catch (const std::domain_error&) {
+                assert(expected == N);
+            }
+        }
+    }
+}
+
+template <unsigned N>
+void TestLogAndSqrtLarge() {
+    Residue<N> g = Residue<N>::getPrimitiveRoot();
+    Residue<N> x(1);
+    for (int i = 0; i < 200; ++i) {
+        x *= Residue<N>(123456789);
+        assert(g.pow(x.log(g)) == x);
+        Residue<N> square = x * x;
+        Residue<N> root = square.sqrt();
+        assert(root * root == square);
+        assert(root == x || root == Residue<N>(0) - x);
+    }
+    try {
+        g.sqrt();
+        assert(false);
+    } catch (const std::domain_error&) {
+    }
+    try {
+        x.log(Residue<N>(0));
+        assert(false);
+    } catch (const std::domain_error&) {
+    }
+}
+
+int main() {
+    TestBinomial<2>(100);
+    TestBinomial<7>(200);
+    TestBinomial<13>(300);
+    TestBinomial<1000000007>(300);
+
+    TestLargeModulus<1000000007>();
+    TestLargeModulus<998244353>();
+
+    TestMulMod();
+    TestFactorize(1'000'000);
+    TestFactorizeLarge();
+    TestPrimitiveRoot(1000);
+
+    TestLogAndSqrt<2>();
+    TestLogAndSqrt<3>();
+    TestLogAndSqrt<13>();
+    TestLogAndSqrt<97>();
+    TestLogAndSqrt<61>();
+    TestLogAndSqrt<9>();
+    TestLogAndSqrt<100>();
+    TestLogAndSqrtLarge<1000000007>();
+    TestLogAndSqrtLarge<998244353>();
+}